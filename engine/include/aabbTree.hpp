@@ -0,0 +1,120 @@
+#pragma once
+
+#include <engine/include/geometryHelper.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// Dynamic bounding volume tree used by the collision broad phase.
+// Leaves store a fattened box so small moves don't touch the tree, inserts pick the sibling
+// with the smallest surface area cost and the tree is kept balanced with AVL rotations.
+class AabbTree {
+public:
+    static constexpr int NULL_NODE = -1;
+
+    // margin added around the leaves' boxes
+    float margin = 0.1f;
+
+    int createProxy(const Bounds &bounds, uint32_t userData);
+    void destroyProxy(int proxy);
+    // returns true if the proxy had to be reinserted
+    bool moveProxy(int proxy, const Bounds &bounds);
+
+    uint32_t getUserData(int proxy) const { return nodes[proxy].userData; }
+    const Bounds& getFatBounds(int proxy) const { return nodes[proxy].bounds; }
+    int getHeight() const { return root == NULL_NODE ? 0 : nodes[root].height; }
+    size_t getProxyCount() const { return proxyCount; }
+
+    // callback(userData) for every leaf overlapping bounds, return false to stop
+    template<typename Callback>
+    void query(const Bounds &bounds, Callback callback) const;
+
+    // callback(userData, maxDistance) for every leaf the ray goes through, it returns the new max distance
+    // (the hit distance to keep the closest hit, maxDistance to keep going, a negative value to stop)
+    template<typename Callback>
+    void raycast(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance, Callback callback) const;
+
+private:
+    struct Node {
+        Bounds bounds;
+        uint32_t userData = 0;
+        int parent = NULL_NODE; // next free node when in the free list
+        int child1 = NULL_NODE;
+        int child2 = NULL_NODE;
+        int height = 0; // leaf = 0, free = -1
+
+        bool isLeaf() const { return child1 == NULL_NODE; }
+    };
+
+    static constexpr int STACK_SIZE = 256;
+
+    // depth first, at most height + 1 nodes wait on the stack: the fixed one unless the tree got too tall
+    int* traversalStack(int *fixedStack, std::vector<int> &largeStack) const {
+        if (nodes[root].height < STACK_SIZE) return fixedStack;
+        largeStack.resize(nodes[root].height + 1);
+        return largeStack.data();
+    }
+
+    std::vector<Node> nodes;
+    int root = NULL_NODE;
+    int freeList = NULL_NODE;
+    size_t proxyCount = 0;
+
+    int allocateNode();
+    void freeNode(int node);
+    void insertLeaf(int leaf);
+    void removeLeaf(int leaf);
+    int balance(int node);
+    void refit(int node);
+};
+
+template<typename Callback>
+void AabbTree::query(const Bounds &bounds, Callback callback) const {
+    if (root == NULL_NODE) return;
+
+    int fixedStack[STACK_SIZE];
+    std::vector<int> largeStack;
+    int *stack = traversalStack(fixedStack, largeStack);
+    int count = 0;
+    stack[count++] = root;
+
+    while (count > 0) {
+        const Node &node = nodes[stack[--count]];
+        if (!node.bounds.overlaps(bounds)) continue;
+
+        if (node.isLeaf()) {
+            if (!callback(node.userData)) return;
+        } else {
+            stack[count++] = node.child1;
+            stack[count++] = node.child2;
+        }
+    }
+}
+
+template<typename Callback>
+void AabbTree::raycast(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance, Callback callback) const {
+    if (root == NULL_NODE) return;
+
+    glm::vec3 invDirection = 1.f / direction;
+
+    int fixedStack[STACK_SIZE];
+    std::vector<int> largeStack;
+    int *stack = traversalStack(fixedStack, largeStack);
+    int count = 0;
+    stack[count++] = root;
+
+    while (count > 0) {
+        const Node &node = nodes[stack[--count]];
+
+        float tMin = 0.f, tMax = maxDistance;
+        if (!node.bounds.intersectRay(origin, invDirection, tMin, tMax)) continue;
+
+        if (node.isLeaf()) {
+            maxDistance = callback(node.userData, maxDistance);
+            if (maxDistance < 0.f) return;
+        } else {
+            stack[count++] = node.child1;
+            stack[count++] = node.child2;
+        }
+    }
+}
@@ -35,6 +35,9 @@ private:
 
 	// Total size of valid entries in the array.
 	size_t mSize;
+
+	// Number of components moved by a removal, pointers to the components are stale once it changes.
+	size_t mMoves = 0;
 public:
 	void InsertData(Entity entity, T &component)
 	{
@@ -56,6 +59,7 @@ public:
 		size_t indexOfRemovedEntity = mEntityToIndexMap[entity];
 		size_t indexOfLastElement = mSize - 1;
 		mComponentArray[indexOfRemovedEntity] = std::move(mComponentArray[indexOfLastElement]);
+		if (indexOfRemovedEntity != indexOfLastElement) ++mMoves;
 
 		// Update map to point to moved spot
 		Entity entityOfLastElement = mIndexToEntityMap[indexOfLastElement];
@@ -76,6 +80,11 @@ public:
 		return mComponentArray[mEntityToIndexMap[entity]];
 	}
 
+	size_t GetMoveCount() const
+	{
+		return mMoves;
+	}
+
 	void EntityDestroyed(Entity entity) override
 	{
 		if (mEntityToIndexMap.find(entity) != mEntityToIndexMap.end())
@@ -139,6 +148,12 @@ public:
 		return GetComponentArray<T>()->GetData(entity);
 	}
 
+	template<typename T>
+	size_t GetComponentMoveCount()
+	{
+		return GetComponentArray<T>()->GetMoveCount();
+	}
+
 	void EntityDestroyed(Entity entity)
 	{
 		// Notify each component array that an entity has been destroyed
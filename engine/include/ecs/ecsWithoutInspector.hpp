@@ -87,6 +87,13 @@ public:
 		return mComponentManager->GetComponent<T>(entity);
 	}
 
+	// changes when a removal moves a T, references kept on T must then be fetched again
+	template<typename T>
+	size_t GetComponentMoveCount()
+	{
+		return mComponentManager->GetComponentMoveCount<T>();
+	}
+
 	template<typename T>
 	ComponentType GetComponentType()
 	{
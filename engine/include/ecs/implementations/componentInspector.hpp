@@ -99,7 +99,8 @@ inline void ComponentInspector<Transform>::DisplayComponentGUI(Transform& transf
     ImGui::SeparatorText("Transform");
     if(ImGui::DragFloat3("Position", &transform.pos.x)) transform.dirty = true;
     
-    if(ImGui::DragFloat3("Rotation", &transform.eulerRotStorage.x)) transform.setLocalRotation(transform.eulerRotStorage);
+    glm::vec3 rotation = transform.getEditorRotation();
+    if(ImGui::DragFloat3("Rotation", &rotation.x)) transform.setLocalRotation(rotation);
 
     if(ImGui::DragFloat3("Scale", &transform.scale.x)) transform.dirty = true;
 }
@@ -122,11 +123,35 @@ inline void ComponentInspector<RigidBody>::DisplayComponentGUI(RigidBody& rigidB
     if(ImGui::DragFloat("Mass", &rigidBody.mass)) rigidBody.dirty = true;
     ImGui::DragFloat("Friction coef", &rigidBody.frictionCoef);
     ImGui::DragFloat("Restitution coef", &rigidBody.restitutionCoef);
+    ImGui::SliderFloat("Linear damping", &rigidBody.linearDamping, 0.f, 1.f);
+    ImGui::Checkbox("Continuous", &rigidBody.continuous);
+    ImGui::Checkbox("Gravity field", &rigidBody.useGravityField);
     ImGui::DragFloat3("Velocity", &rigidBody.velocity[0]);
     ImGui::DragFloat3("Angular velocity", &rigidBody.angularVelocity[0]);
 
 }
 
+template<>
+inline void ComponentInspector<GravitySource>::DisplayComponentGUI(GravitySource& source) {
+    ImGui::SeparatorText("Gravity source");
+    ImGui::DragFloat("Mass", &source.mass, 10.f, 0.f);
+}
+
+template<>
+inline void ComponentInspector<Orbit>::DisplayComponentGUI(Orbit& orbit) {
+    ImGui::SeparatorText("Orbit");
+    ImGui::Text("%s", orbit.onRails ? "On rails" : "Integrated");
+    ImGui::DragFloat("Semi-major axis", &orbit.semiMajorAxis, 0.1f, 0.01f, 1e6f);
+    ImGui::SliderFloat("Eccentricity", &orbit.eccentricity, 0.f, 0.99f);
+    ImGui::SliderAngle("Inclination", &orbit.inclination, 0.f, 180.f);
+    ImGui::SliderAngle("Ascending node", &orbit.ascendingNode);
+    ImGui::SliderAngle("Periapsis argument", &orbit.periapsisArgument);
+    ImGui::SliderAngle("Mean anomaly at epoch", &orbit.meanAnomalyAtEpoch);
+    ImGui::DragFloat("Gravitational parameter", &orbit.gravitationalParameter, 10.f, 0.01f, 1e6f);
+    ImGui::DragFloat("Influence radius", &orbit.influenceRadius, 1.f, 0.f, 1e6f);
+    ImGui::SliderFloat("Influence hysteresis", &orbit.influenceHysteresis, 0.f, 1.f);
+}
+
 template<>
 inline void ComponentInspector<CollisionShape>::DisplayComponentGUI(CollisionShape& collisionShape) {
     ImGui::SeparatorText("Collision shape");
@@ -147,6 +172,12 @@ inline void ComponentInspector<CollisionShape>::DisplayComponentGUI(CollisionSha
         ImGui::DragFloat3("Half", &collisionShape.aabb.diag[0]);
     } else if(collisionShape.shapeType == OOBB){
         ImGui::DragFloat3("Half", &collisionShape.oobb.halfExtents[0], 0.2f, 0.01f);
+    } else if(collisionShape.shapeType == TRIANGLE_MESH && collisionShape.triangleMesh.data){
+        ImGui::Text("Triangle mesh: %zu triangles", collisionShape.triangleMesh.data->triangleCount());
+    } else if(collisionShape.shapeType == HEIGHTFIELD && collisionShape.heightfield.data){
+        ImGui::Text("Heightfield: %d x %d", collisionShape.heightfield.data->width, collisionShape.heightfield.data->depth);
+    } else if(collisionShape.shapeType == COMPOUND && collisionShape.compound.data){
+        ImGui::Text("Compound: %zu children", collisionShape.compound.data->children.size());
     }
 
 }
@@ -226,6 +257,14 @@ inline json ComponentInspector<RigidBody>::GetComponentJson(RigidBody& rigidBody
     return {{"name", "RigidBody"}};
 }
 template<>
+inline json ComponentInspector<GravitySource>::GetComponentJson(GravitySource& source){
+    return {{"name", "GravitySource"}};
+}
+template<>
+inline json ComponentInspector<Orbit>::GetComponentJson(Orbit& orbit){
+    return {{"name", "Orbit"}};
+}
+template<>
 inline json ComponentInspector<CollisionShape>::GetComponentJson(CollisionShape& collisionShape){
     return {{"name", "CollisionShape"}};
 }
@@ -12,6 +12,10 @@
 #include <imgui.h>
 #include <engine/include/rendering.hpp>
 #include <engine/include/animation.hpp>
+#include <engine/include/simd.hpp>
+#include <engine/include/geometryHelper.hpp>
+#include <engine/include/meshCollider.hpp>
+#include <engine/include/staticBvh.hpp>
 
 template<typename T>
 class ComponentInspector;
@@ -40,12 +44,19 @@ struct Drawable: Component {
     Drawable* lodLower = nullptr;
     float switchDistance = -1.0f;
 
+    // mesh space, computed from the vertices by init
+    Bounds localBounds;
+    BoundingSphere localSphere;
+    // hash of the vertices and indices, drawables with the same key can be drawn from one VAO
+    uint64_t meshKey = 0;
+
     Drawable(): VAO(0), VBO(0), EBO(0){};
 
     Drawable(Drawable&& other) noexcept
         : VAO(other.VAO), VBO(other.VBO), EBO(other.EBO), 
           indexCount(other.indexCount),
-          lodLower(other.lodLower), switchDistance(other.switchDistance) {
+          lodLower(other.lodLower), switchDistance(other.switchDistance),
+          localBounds(other.localBounds), localSphere(other.localSphere), meshKey(other.meshKey) {
         other.VAO = 0;
         other.VBO = 0;
         other.EBO = 0;
@@ -63,6 +74,9 @@ struct Drawable: Component {
             indexCount = other.indexCount;
             lodLower = other.lodLower;
             switchDistance = other.switchDistance;
+            localBounds = other.localBounds;
+            localSphere = other.localSphere;
+            meshKey = other.meshKey;
 
             other.VAO = 0;
             other.VBO = 0;
@@ -85,7 +99,12 @@ struct Drawable: Component {
     }
 
     void init(std::vector<Vertex>&, std::vector<short unsigned int>&);
+    void computeBounds(const std::vector<Vertex> &vertices);
     void draw(float renderDistance);
+    // level of detail drawn at this distance
+    Drawable& lodAt(float renderDistance);
+    // the VAO must be bound
+    void drawElements();
 };
 
 struct AnimatedDrawable: Drawable{
@@ -133,16 +152,20 @@ enum RotationOrderEnum {
 class Transform: Component {
     private:
     friend class ComponentInspector<Transform>;
+    friend class SceneGraph;
 
     glm::vec3 pos = { 0.0f, 0.0f, 0.0f };
     glm::vec3 scale = { 1.0f, 1.0f, 1.0f };
     glm::mat4 modelMatrix = glm::mat4(1.f);
     glm::quat rotationQuat = glm::quat();
 
+    // angles shown by the inspector, only recomputed from the quaternion when it asks for them
     glm::vec3 eulerRotStorage = glm::vec3(0);
     bool eulerStorageDirty = true;
 
     bool dirty = true;
+    // bumped each time the model matrix is recomputed
+    uint32_t version = 0;
 
     glm::mat4 getLocalModelMatrix();
 
@@ -154,6 +177,7 @@ class Transform: Component {
     void computeModelMatrix(const glm::mat4& parentGlobalModelMatrix);
 
     bool isDirty();
+    uint32_t getVersion() const { return version; }
     
     void setLocalPosition(glm::vec3 position);
     glm::vec3 getLocalPosition();
@@ -162,6 +186,8 @@ class Transform: Component {
     void setScale(glm::vec3 value);
     
     glm::vec3 getLocalRotation();
+    // euler angles of the last setLocalRotation, or converted from the quaternion if it changed since
+    const glm::vec3& getEditorRotation();
     void setLocalRotation(glm::vec3 rotationAngles);
     // void setLocalRotation(glm::quat rotationQuat);
     void setLocalRotation(const glm::quat &q) ;
@@ -186,6 +212,7 @@ class Transform: Component {
           scale(std::move(other.scale)),
           modelMatrix(std::move(other.modelMatrix)),
           dirty(other.dirty),
+          version(other.version),
           rotationOrder(other.rotationOrder)
     {
         other.dirty = true;
@@ -198,6 +225,7 @@ class Transform: Component {
             scale = std::move(other.scale);
             modelMatrix = std::move(other.modelMatrix);
             dirty = other.dirty;
+            version = other.version;
             rotationOrder = other.rotationOrder;
 
             other.dirty = true;
@@ -261,12 +289,23 @@ struct RigidBody: Component {
     
     glm::vec3 angularVelocity=glm::vec3(0);
 
+    // local position before the last physic step, for render interpolation
+    glm::vec3 previousPosition = glm::vec3(0);
+    bool hasPreviousPosition = false;
+
     glm::mat3 invInertia = glm::mat3(0.4);
     
     float mass=1.f;
     float invMass = 1.f;
     float restitutionCoef=0.5f;
     float frictionCoef=0.6f;
+    // velocity factor applied each step, 1 keeps the motion undamped (orbits)
+    float linearDamping = 0.98f;
+
+    // fast body: its motion is swept each step so it can't tunnel through thin colliders
+    bool continuous = false;
+    // pulled by the GravitySource entities (GravityFieldSystem) instead of the direction / anchor gravity
+    bool useGravityField = false;
 
 
     RigidBody() = default;
@@ -276,7 +315,10 @@ struct RigidBody: Component {
           velocity(std::move(other.velocity)),
           mass(other.mass),
           restitutionCoef(other.restitutionCoef),
-          frictionCoef(other.frictionCoef)
+          frictionCoef(other.frictionCoef),
+          linearDamping(other.linearDamping),
+          continuous(other.continuous),
+          useGravityField(other.useGravityField)
     {
         other.mass = 1.f; // Ou autre valeur par défaut
         other.restitutionCoef = 0.5f;
@@ -291,6 +333,9 @@ struct RigidBody: Component {
             mass = other.mass;
             restitutionCoef = other.restitutionCoef;
             frictionCoef = other.frictionCoef;
+            linearDamping = other.linearDamping;
+            continuous = other.continuous;
+            useGravityField = other.useGravityField;
 
             other.mass = 1.f;
             other.restitutionCoef = 0.5f;
@@ -307,10 +352,43 @@ struct RigidBody: Component {
 
     void applyForces();
     void addLinearImpulse(const glm::vec3 &impulse);
+    // moves the body without interpolating from where it was
+    void teleport(Transform &transform, const glm::vec3 &localPosition);
     void update(float delta);
 };
 
 
+// Massive body attracting the rigid bodies flagged useGravityField, field = gravitationalConstant * mass / distance²
+struct GravitySource: Component {
+    float mass = 1000.f;
+};
+
+// Keplerian orbit around the origin of the parent node: the local position is computed from the elements at
+// any time instead of being integrated. Angles in radians, reference plane XZ, prograde is counterclockwise seen from +Y.
+struct Orbit: Component {
+    float semiMajorAxis = 10.f;
+    float eccentricity = 0.f; // [0, 1[
+    float inclination = 0.f;
+    float ascendingNode = 0.f; // longitude of the ascending node
+    float periapsisArgument = 0.f;
+    float meanAnomalyAtEpoch = 0.f;
+    double epoch = 0.0;
+    // G * mass of the orbited body, match its GravitySource (and use an undamped rigid body) so the body
+    // keeps its orbit once integrated
+    float gravitationalParameter = 1000.f;
+
+    // a rigid body closer than this to the OrbitSystem focus leaves the rails and is integrated,
+    // it gets back on them past influenceRadius * (1 + influenceHysteresis) so it doesn't flicker at the boundary
+    float influenceRadius = 50.f;
+    float influenceHysteresis = 0.1f;
+    bool onRails = true;
+
+    // position and velocity in the parent's frame, the orbited body being the parent's origin
+    void stateAt(double time, glm::vec3 &position, glm::vec3 &velocity) const;
+    // fits the elements to a local position and velocity, false if the trajectory isn't a bound orbit
+    bool setState(const glm::vec3 &position, const glm::vec3 &velocity, double time);
+};
+
 
 struct OverlapingShape {
     bool exist = false;
@@ -318,6 +396,8 @@ struct OverlapingShape {
     bool aSeeB, bSeeA;
     glm::vec3 position, normal;
     float correctionDepth;
+    // a trigger child of the compound A (B) overlaps the other shape, with or without a contact
+    bool triggerA = false, triggerB = false;
 };
 
 enum CollisionShapeTypeEnum {
@@ -325,8 +405,12 @@ enum CollisionShapeTypeEnum {
     SPHERE,
     PLANE,
     AABB,
-    OOBB
+    OOBB,
+    TRIANGLE_MESH,
+    HEIGHTFIELD,
+    COMPOUND
 };
+constexpr int COLLISION_SHAPE_TYPE_COUNT = COMPOUND + 1;
 
 struct Ray {
     Ray() = default;
@@ -345,16 +429,64 @@ struct Plane {
     glm::vec3 left{1,0,0};
 };
 
+struct WorldOobb {
+    glm::vec3 center;
+    glm::vec3 axes[3]; // normalized
+    glm::vec3 halfExtents; // scale included
+};
+
 struct Oobb {
     Oobb() = default;
     glm::vec3 halfExtents{1};
+
+    WorldOobb toWorld(const glm::mat4 &modelMatrix) const;
 };
 
+// structure of arrays, one box per simd lane
+struct WorldOobbBatch {
+    float center[3][simd::WIDTH];
+    float axes[3][3][simd::WIDTH];
+    float halfExtents[3][simd::WIDTH];
+
+    void set(int lane, const WorldOobb &oobb);
+    // unit box at the origin in the lanes from firstLane, the kernel loads every lane
+    void clear(int firstLane);
+};
+
+// world space data of a shape, refreshed once per frame by the collision system
+struct WorldCollider {
+    glm::vec3 position;
+    glm::vec3 direction, unitDirection; // RAY
+    glm::vec3 normal; // PLANE, normalized
+    WorldOobb oobb; // OOBB
+    glm::mat4 modelMatrix, invModelMatrix; // OOBB, TRIANGLE_MESH, HEIGHTFIELD, COMPOUND
+};
+
+OverlapingShape oobbIntersection(const WorldOobb &oobbA, const WorldOobb &oobbB);
+void oobbIntersectionBatch(const WorldOobb &oobbA, const WorldOobbBatch &others, int count, OverlapingShape *results);
+
 struct Aabb {
     Aabb() = default;
     glm::vec3 diag{1};
 };
 
+// mesh colliders point to shared data (TriangleMeshData::loadMesh, HeightfieldData::loadHeightmap...)
+struct TriangleMesh {
+    TriangleMesh() = default;
+    const TriangleMeshData *data = nullptr;
+};
+
+struct Heightfield {
+    Heightfield() = default;
+    const HeightfieldData *data = nullptr;
+};
+
+struct CompoundShapeData;
+struct Compound {
+    Compound() = default;
+    const CompoundShapeData *data = nullptr;
+};
+
 
 struct CollisionShape: Component{
     static uint16_t ENV_LAYER, PLAYER_LAYER, GRAVITY_SENSITIVE_LAYER;
@@ -366,12 +498,21 @@ struct CollisionShape: Component{
         Plane plane;
         Aabb aabb;
         Oobb oobb;
+        TriangleMesh triangleMesh;
+        Heightfield heightfield;
+        Compound compound;
     };
     
     uint16_t layer = 1;
     uint16_t mask = 1;
 
     std::unordered_set<Entity> collidingEntities;
+
+    WorldCollider world;
+    WorldCollider computeWorld(Transform &transform) const;
+    WorldCollider computeWorld(const glm::mat4 &modelMatrix) const;
+    void updateWorld(Transform &transform);
+
     bool isColliding(Entity entity) {
         return collidingEntities.find(entity) != collidingEntities.end();
     }
@@ -390,7 +531,7 @@ struct CollisionShape: Component{
     }
 
     CollisionShape(CollisionShape&& other) noexcept 
-        : shapeType(other.shapeType), collidingEntities(other.collidingEntities) {
+        : shapeType(other.shapeType), collidingEntities(other.collidingEntities), world(other.world) {
         switch (other.shapeType) {
             case RAY:
                 new(&ray) Ray(std::move(other.ray));
@@ -407,6 +548,15 @@ struct CollisionShape: Component{
             case OOBB:
                 new(&oobb) Oobb(std::move(other.oobb));
                 break;
+            case TRIANGLE_MESH:
+                new(&triangleMesh) TriangleMesh(std::move(other.triangleMesh));
+                break;
+            case HEIGHTFIELD:
+                new(&heightfield) Heightfield(std::move(other.heightfield));
+                break;
+            case COMPOUND:
+                new(&compound) Compound(std::move(other.compound));
+                break;
         }
         other.collidingEntities.clear();
         layer = other.layer;
@@ -417,6 +567,7 @@ struct CollisionShape: Component{
         if (this != &other) {
             shapeType = other.shapeType;
             collidingEntities = other.collidingEntities;
+            world = other.world;
 
             switch (other.shapeType) {
                 case RAY:
@@ -434,6 +585,15 @@ struct CollisionShape: Component{
                 case OOBB:
                     new(&oobb) Oobb(std::move(other.oobb));
                     break;
+                case TRIANGLE_MESH:
+                    new(&triangleMesh) TriangleMesh(std::move(other.triangleMesh));
+                    break;
+                case HEIGHTFIELD:
+                    new(&heightfield) Heightfield(std::move(other.heightfield));
+                    break;
+                case COMPOUND:
+                    new(&compound) Compound(std::move(other.compound));
+                    break;
             }
             other.collidingEntities.clear();
             layer = other.layer;
@@ -459,10 +619,54 @@ struct CollisionShape: Component{
             case OOBB:
                 oobb.~Oobb();
                 break;
+            case TRIANGLE_MESH:
+                triangleMesh.~TriangleMesh();
+                break;
+            case HEIGHTFIELD:
+                heightfield.~Heightfield();
+                break;
+            case COMPOUND:
+                compound.~Compound();
+                break;
         }
     }
 
     static OverlapingShape intersectionExist(CollisionShape &shapeA, Transform &transformA, CollisionShape &shapeB, Transform &transformB);
+    // uses the cached world data
+    static OverlapingShape intersectionExist(const CollisionShape &shapeA, const CollisionShape &shapeB);
+
+    // time of impact in [0,1] of `moving` going from start to start + displacement against the cached `target`, -1 if none,
+    // if they already overlap at start or if the advancement doesn't converge. normal points from target to moving
+    static float timeOfImpact(const CollisionShape &moving, const glm::vec3 &start, const glm::vec3 &displacement, const CollisionShape &target, glm::vec3 &normal);
+    float boundingRadius() const;
+    // from the cached world data, false for unbounded shapes (rays and planes)
+    bool worldBounds(Bounds &bounds) const;
+    // closest hit distance along a normalized direction, -1 if none within maxDistance
+    float rayIntersection(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance, glm::vec3 &normal) const;
 
     static bool canSee(CollisionShape &checker, CollisionShape &checked);
 };
+
+struct CompoundChild {
+    CollisionShape shape;
+    glm::mat4 localMatrix;
+    bool trigger = false;
+};
+
+// Primitives sharing one collider (and one broad phase proxy), placed relative to the entity.
+// Children are found through a bvh over their local bounds, their layer and mask are the compound's ones.
+// Trigger children push nothing: the shapes their own mask sees are added to the compound's collidingEntities.
+struct CompoundShapeData {
+    std::vector<CompoundChild> children;
+    StaticBvh tree;
+    Bounds bounds;
+
+    // spheres, boxes and meshes only
+    void addChild(CollisionShape &&shape, const glm::vec3 &position, const glm::quat &rotation = glm::quat(1.f, 0.f, 0.f, 0.f));
+    void addTrigger(CollisionShape &&shape, const glm::vec3 &position);
+    // to call once the children are added
+    void build();
+
+    static CompoundShapeData& create(const std::string &key);
+    static std::map<std::string, CompoundShapeData> compounds;
+};
@@ -4,15 +4,65 @@
 #include <engine/include/ecs/implementations/components.hpp>
 #include <engine/include/ecs/ecsManager.hpp>
 #include <engine/include/rendering.hpp>
+#include <engine/include/aabbTree.hpp>
+#include <engine/include/staticBvh.hpp>
+#include <engine/include/gravityOctree.hpp>
 
+class SceneGraph;
+
+#include <cstring>
+#include <map>
 #include <stack>
+#include <unordered_map>
 
 
 extern ecsManager ecs;
 
+struct VisibleSet;
+class BoundsSystem;
+
+struct RenderItem {
+    uint64_t key;
+    Drawable *drawable; // level of detail already chosen
+    Program *program;
+    Material *material; // null for the programs without material
+    glm::mat4 model;
+    float distance;
+    int boneOffset; // first matrix of the skinned drawables in the bone palette
+    uint16_t programRank, materialRank, meshRank;
+};
+
+// Draws of one render system for one view, sorted by a 64 bits key so the state only changes between runs of
+// equal state: program (8 bits) | material (16 bits) | mesh (16 bits) | distance to the camera (24 bits).
+// Within a state bucket the items go front to back for early-Z. Programs, materials and meshes are ranked in
+// order of first appearance, materials by value since every entity owns its Material, meshes by
+// Drawable::meshKey so the copies of a mesh follow each other and can be instanced.
+class RenderQueue {
+    public:
+        void clear();
+        void push(Drawable &drawable, Program *program, Material *material, const glm::mat4 &model, float distance, int boneOffset = 0);
+        void sort();
+        const std::vector<RenderItem>& getItems() const { return items; }
+
+    private:
+        struct MaterialKey {
+            float values[6]; // albedo, metallic, roughness, ao
+            const Texture *textures[5]; // null when not visible
+            bool operator<(const MaterialKey &other) const { return std::memcmp(this, &other, sizeof(MaterialKey)) < 0; }
+        };
+        std::vector<RenderItem> items;
+        std::unordered_map<Program*, uint16_t> programRanks;
+        std::map<MaterialKey, uint16_t> materialRanks;
+        std::unordered_map<uint64_t, uint16_t> meshRanks;
+};
+
 class Render: public System {
+    RenderQueue queue;
+
     public:
-    void update(glm::mat4 &view, bool isCubemapRender = false);
+    // entities culled in visible aren't drawn
+    // with the view set in CameraUniforms
+    void update(const VisibleSet *visible = nullptr, bool isCubemapRender = false);
 
     static Drawable generateSphere(float radius);
     static Drawable generatePlane(float sideLength, int nbOfVerticesSide);
@@ -30,15 +80,28 @@ class PBRrender: public System {
     protected:
     friend LightRender;
     static PBR* pbrProgPtr;
+    // buffer texture of the skinning matrices written by AnimatedPBRrender, the PBR program samples it
+    // for every draw so it is bound by both
+    static GLuint bonePaletteBuffer, bonePaletteTexture;
     GLuint mIrradianceMapID = 0; 
     GLuint mPrefilterMapID = 0; 
     GLuint mBrdfLUTID = 0; 
+    RenderQueue queue;
+
+    // model matrices of the queue in sorted order, only the changed range is uploaded
+    GLuint instanceBuffer = 0;
+    size_t instanceCapacity = 0;
+    std::vector<glm::mat4> instanceModels, uploadedModels;
+    size_t drawCalls = 0;
+
+    void uploadInstances();
+    void drawInstanced(const RenderItem &item, size_t first, size_t count);
 
 
     public:
     static void initPBR();
     void setupMaps();
-    virtual void update(glm::mat4 &view, bool isCubemapRender = false);
+    virtual void update(const VisibleSet *visible = nullptr, bool isCubemapRender = false);
     void setIrradianceMap(GLuint cubemapTextureID) {
         mIrradianceMapID = cubemapTextureID;
     }
@@ -48,12 +111,24 @@ class PBRrender: public System {
     void setBrdfLUT(GLuint TextureID) {
         mBrdfLUTID = TextureID;
     }
+
+    // runs of at least this many draws of the same mesh and material are instanced
+    size_t minInstances = 2;
+    // of the last update
+    size_t getDrawCalls() const { return drawCalls; }
+    size_t getDrawnItems() const { return queue.getItems().size(); }
 };
 
 
 class AnimatedPBRrender: public PBRrender {
+    private:
+    // bone matrices of the drawn entities, uploaded once per update
+    std::vector<glm::mat4> palette;
+
+    void uploadPalette();
+
     public:
-    void update(glm::mat4 &view, float deltaTime);
+    void update(float deltaTime, const VisibleSet *visible = nullptr);
     static void loadMesh(char *directory, char *fileName, AnimatedDrawable &res, Material &mat);
 };
 
@@ -66,13 +141,68 @@ class CubemapRender {
     public:
     Cubemap cubemap;
     CubemapRender(int res);
-    void renderFromPoint(glm::vec3 point, Render *render, PBRrender *pbr);
+    void renderFromPoint(glm::vec3 point, Render *render, PBRrender *pbr, BoundsSystem *bounds = nullptr);
     void applyFilter(Program *filterProg, Cubemap target);
     void applyPrefilter(Program *filterProg, Cubemap prefilterMap);
     GLuint TwoDLUT(Program *brdfProg);
 };
 
 
+// Entities of one view that passed the frustum test, filled by BoundsSystem::cull.
+// Entities without bounds are never tested, so never culled.
+struct VisibleSet {
+    std::vector<Entity> entities; // visible, ascending
+    std::vector<char> culledFlags; // indexed by entity
+    size_t tested = 0;
+    size_t culled = 0;
+
+    bool isCulled(Entity entity) const { return entity < culledFlags.size() && culledFlags[entity]; }
+};
+
+// Skinned drawables, only holds the entities: BoundsSystem bounds them with their padded bind pose.
+class AnimatedBoundsSystem: public System {};
+
+// World space box and sphere of the drawables, shared by the culling, the LOD and the spatial queries.
+// Refreshed after the transforms propagation, only for the entities whose model matrix was recomputed
+// (Transform::getVersion) since the last update. getVersion(entity) is bumped by each refresh so a
+// consumer can cache what it derives from the bounds.
+class BoundsSystem: public System {
+    public:
+        void update();
+
+        const Bounds& getBounds(Entity entity) const { return bounds[entity]; }
+        const BoundingSphere& getSphere(Entity entity) const { return spheres[entity]; }
+        uint32_t getVersion(Entity entity) const { return versions[entity]; }
+        // entities refreshed by the last update
+        size_t getRefreshCount() const { return refreshCount; }
+
+        // bounding spheres against the frustum of viewProjection, simd::WIDTH spheres at a time on the job system
+        void cull(const glm::mat4 &viewProjection, VisibleSet &out);
+        size_t minSpheresPerChunk = 256;
+
+        AnimatedBoundsSystem *animated = nullptr;
+        // the bind pose box of a skinned mesh grows by this fraction of its largest side, the pose can leave it
+        float animatedPadding = 0.25f;
+
+    private:
+        // indexed by entity
+        std::vector<Bounds> bounds;
+        std::vector<BoundingSphere> spheres;
+        std::vector<uint32_t> versions;
+        std::vector<uint32_t> transformVersions;
+        std::vector<char> tracked;
+        std::vector<Entity> trackedEntities;
+        size_t refreshCount = 0;
+
+        void refresh(Entity entity, const Bounds &local, const BoundingSphere &localSphere, Transform &transform);
+
+        // spheres of mEntities and of the animated entities in SoA, padded to simd::WIDTH, for the culling kernel
+        std::vector<float> centersX, centersY, centersZ, radii;
+        std::vector<Entity> denseEntities;
+        // one visible list per job chunk, merged in chunk order
+        std::vector<std::vector<Entity>> chunkVisible;
+};
+
 class CameraSystem: public System {
     private:
         std::stack<Entity> cams;
@@ -81,30 +211,214 @@ class CameraSystem: public System {
 };
 
 
+struct RaycastHit {
+    bool hit = false;
+    Entity entity;
+    float distance;
+    glm::vec3 position, normal;
+};
+
+struct RayQuery {
+    glm::vec3 origin;
+    glm::vec3 direction;
+    float maxDistance;
+    uint16_t mask = 0xFFFF;
+};
+
 class CollisionDetectionSystem: public System {
+    public:
+        // counters of the last update, times in milliseconds
+        struct Stats {
+            size_t proxies = 0; // bounded colliders, in the dynamic tree or the static bvh
+            size_t unbounded = 0; // rays and planes
+            size_t candidatePairs = 0;
+            size_t layerRejectedPairs = 0; // bounds overlapping but neither shape sees the other
+            // candidate pairs by shape types, smallest type first
+            size_t narrowTests[COLLISION_SHAPE_TYPE_COUNT][COLLISION_SHAPE_TYPE_COUNT] = {};
+            size_t contacts = 0;
+            double broadPhaseTime = 0.0, narrowPhaseTime = 0.0;
+        };
+
     private:
-        // void broadPhase();
+        Stats stats;
+
+        struct CandidatePair {
+            Entity entityA, entityB;
+            CollisionShape *shapeA, *shapeB;
+            bool aSeeB, bSeeA;
+        };
+
+        // broad phase, indexed by entity
+        // dynamic tree for everything that moves, static bvh for STATIC rigid bodies (static pairs are never tested)
+        AabbTree tree;
+        StaticBvh staticTree;
+        std::vector<char> isStatic, hasBounds;
+        std::vector<glm::mat4> staticMatrices;
+        bool staticTreeDirty = true;
+        std::vector<int> proxies;
+        std::vector<CollisionShape*> shapes;
+        std::vector<Bounds> entityBounds;
+        std::vector<Entity> trackedEntities;
+        // rays and planes, paired with everything
+        std::vector<Entity> unboundedEntities;
+        std::vector<Entity> partners;
+
+        std::vector<CandidatePair> candidatePairs;
+        // one contact buffer per job chunk, merged in chunk order
+        std::vector<std::vector<OverlapingShape>> chunkContacts;
+        size_t minPairsPerChunk = 64;
+
+        bool shouldBeStatic(Entity entity);
+        void updateProxies();
+        void broadPhase();
         void narrowPhase();
+
+        template<typename Test>
+        void overlapQuery(const Bounds &bounds, uint16_t mask, Test test, std::vector<Entity> &results) const;
         
     public: 
         void update(float deltaTime);
+        // called at scene load, then again only if a static collider is added, removed or moved
+        void buildStaticTree();
+
+        // Scene queries, answered from the colliders as they were at the last update.
+        // mask is tested against the shapes' layer, directions don't need to be normalized
+        bool raycast(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance, uint16_t mask, RaycastHit &hit) const;
+        bool sphereCast(const glm::vec3 &origin, float radius, const glm::vec3 &direction, float maxDistance, uint16_t mask, RaycastHit &hit) const;
+        void overlapSphere(const glm::vec3 &center, float radius, uint16_t mask, std::vector<Entity> &results) const;
+        void overlapBox(const glm::vec3 &center, const glm::vec3 &halfExtents, const glm::quat &rotation, uint16_t mask, std::vector<Entity> &results) const;
+        // many rays at once (line of sight...), spread on the job system, hits[i] answers rays[i]
+        void raycastBatch(const std::vector<RayQuery> &rays, std::vector<RaycastHit> &hits) const;
+
+        const Stats& getStats() const { return stats; }
+};
+
+// Pull of every GravitySource, evaluated with a Barnes-Hut octree rebuilt each physic step
+class GravityFieldSystem: public System {
+    private:
+        GravityOctree octree;
+        std::vector<glm::vec3> sourcePositions;
+        std::vector<float> sourceMasses;
+    public:
+        // cell size / distance under which a cell pulls as one mass, lower is more accurate
+        float theta = 0.5f;
+        // O(n²) reference: every source is summed for every body
+        bool exact = false;
+        float gravitationalConstant = 1.f;
+        float softening = 0.1f;
+        size_t minPointsPerChunk = 64;
+
+        // rebuilds the octree from the current source positions
+        void update();
+        glm::vec3 fieldAt(const glm::vec3 &point) const;
+        // field at (position[0][i], position[1][i], position[2][i]) where mask[i] > 0, 0 elsewhere
+        void evaluate(const std::vector<float> (&position)[3], const std::vector<float> &mask, std::vector<float> (&field)[3], size_t count) const;
+        const GravityOctree& getOctree() const { return octree; }
+};
+
+// Moves the Orbit entities along their orbit. Rigid bodies stay kinematic on the rails and become rigid,
+// pulled by the gravity field, inside the influence radius of the focus (camera or player).
+class OrbitSystem: public System {
+    public:
+        double time = 0.0;
+        // gives the parent frame the orbits are expressed in, world frame without it
+        SceneGraph *sceneGraph = nullptr;
+
+        void update(float deltaTime, const glm::vec3 &focus);
 };
 
 class PhysicSystem: public System {
+    public:
+        // counters of the last step, times in milliseconds
+        struct Stats {
+            size_t rigidBodies = 0, kinematicBodies = 0, staticBodies = 0;
+            size_t solvedContacts = 0, colors = 0, serialContacts = 0;
+            int solverIterations = 0;
+            // fastest approach along a contact normal left after the iterations, 0 once converged
+            float solverResidual = 0.f;
+            double prepareTime = 0.0, solverTime = 0.0, correctionTime = 0.0, integrationTime = 0.0;
+        };
+
     private:
+        Stats stats;
+
+        // dynamic bodies gathered as structure of arrays for the integration kernel
+        struct BodyArrays {
+            std::vector<RigidBody*> rigidBodies;
+            std::vector<Transform*> transforms;
+            std::vector<float> position[3], anchor[3], gravityDirection[3], velocity[3];
+            std::vector<float> useAnchor, mass, invMass, damping;
+            std::vector<float> useField, field[3];
+            std::vector<float> forces[3], displacement[3];
+            // bodies flagged continuous, index in the arrays above
+            std::vector<size_t> continuousIndices;
+            std::vector<CollisionShape*> continuousShapes;
+            size_t count = 0;
+
+            void resize(size_t size);
+        };
+        BodyArrays bodies;
+
+        // contacts of the step sorted by color: two contacts of the same color never share a rigid body,
+        // so a color is solved in parallel, simd::WIDTH contacts at a time
+        struct ContactArrays {
+            std::vector<uint32_t> bodyA, bodyB; // index in SolverBodies
+            std::vector<float> normal[3], restitution, friction, invMassSum;
+            std::vector<std::pair<size_t, size_t>> colors; // [begin, end) of each color
+            size_t serialBegin = 0; // contacts that found no free color, solved one by one
+            size_t count = 0;
+
+            // detection order, before the sort by color
+            struct Pending { const OverlapingShape *shape; uint32_t a, b; int color; };
+            std::vector<Pending> pending;
+
+            void resize(size_t size);
+        };
+        // velocities of the bodies touched by a contact, written back once the iterations are done
+        struct SolverBodies {
+            std::vector<RigidBody*> rigidBodies;
+            std::vector<Entity> entities;
+            std::vector<float> velocity[3];
+            std::vector<float> velocityWeight; // invMass for rigid bodies, 0 for the ones the solver does not move
+            std::vector<uint64_t> usedColors;
+            std::vector<int> entityIndex; // -1 when the entity is not gathered
+        };
+        static constexpr int MAX_COLORS = 64;
+        ContactArrays contacts;
+        SolverBodies solverBodies;
+        size_t minContactGroupsPerChunk = 8;
+
+        std::vector<std::pair<Transform*, glm::vec3>> interpolatedTransforms;
+        std::vector<std::pair<CollisionShape*, RigidBody*>> sweepTargets;
+        static void integrationKernel(BodyArrays &bodies, size_t padded, float deltaTime);
+
+        void prepareContacts();
+        void solveContacts(size_t first, int count);
         void solver();
+        float contactResidual() const;
+        void storeVelocities();
         void accumulateForces();
+        void integrate(float deltaTime);
+        void sweepContinuousBodies(float deltaTime);
         // float linearProjectionPercent = 0.8f;
         // float penetrationSlack = 0.1;
         int impulseIteration = 20;
     public:
+        // set when the scene has gravity sources, bodies flagged useGravityField follow it
+        GravityFieldSystem *gravityField = nullptr;
+
         void update(float deltaTime);
+        // moves rigid bodies between their two last physic states (alpha in [0,1]) until removeInterpolation
+        void applyInterpolation(float alpha);
+        void removeInterpolation();
+        const Stats& getStats() const { return stats; }
         static glm::mat3 processInvertInertia(CollisionShape &shape, RigidBody &rigidBody);
 };
 
 class PhysicDebugSystem: public System {
     private:
     Program program;
+    UniformHandle scaleUniform, colorUniform;
     GLuint sphereVAO, quadVAO, rayVAO, boxVAO;
     int sphereIndexCount, quadIndexCount, boxIndexCount;
 
@@ -3,3 +3,112 @@
 
 glm::vec3 rotateY(glm::vec3 in, float angle);
 glm::vec3 rotateX(glm::vec3 in, float angle);
+
+// axis aligned bounding box in world space
+struct Bounds {
+    glm::vec3 min{0};
+    glm::vec3 max{0};
+
+    Bounds() = default;
+    Bounds(const glm::vec3 &min, const glm::vec3 &max): min(min), max(max) {}
+
+    static Bounds fromCenter(const glm::vec3 &center, const glm::vec3 &halfExtents) {
+        return Bounds(center - halfExtents, center + halfExtents);
+    }
+
+    glm::vec3 center() const { return (min + max) * 0.5f; }
+    glm::vec3 extents() const { return max - min; }
+
+    float surfaceArea() const {
+        glm::vec3 d = max - min;
+        return 2.f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+
+    bool overlaps(const Bounds &other) const {
+        return min.x <= other.max.x && max.x >= other.min.x &&
+               min.y <= other.max.y && max.y >= other.min.y &&
+               min.z <= other.max.z && max.z >= other.min.z;
+    }
+
+    bool contains(const Bounds &other) const {
+        return min.x <= other.min.x && min.y <= other.min.y && min.z <= other.min.z &&
+               max.x >= other.max.x && max.y >= other.max.y && max.z >= other.max.z;
+    }
+
+    Bounds merged(const Bounds &other) const {
+        return Bounds(glm::min(min, other.min), glm::max(max, other.max));
+    }
+
+    Bounds expanded(float margin) const {
+        return Bounds(min - glm::vec3(margin), max + glm::vec3(margin));
+    }
+
+    // box enclosing this one once transformed
+    Bounds transformed(const glm::mat4 &matrix) const {
+        glm::vec3 newCenter = glm::vec3(matrix * glm::vec4(center(), 1.f));
+        glm::vec3 half = extents() * 0.5f;
+        glm::vec3 newHalf(0);
+        for (int i = 0; i < 3; i++) newHalf += glm::abs(glm::vec3(matrix[i])) * half[i];
+        return fromCenter(newCenter, newHalf);
+    }
+
+    // slab test, tMin/tMax are narrowed to the part of the ray inside the box
+    bool intersectRay(const glm::vec3 &origin, const glm::vec3 &invDirection, float &tMin, float &tMax) const {
+        for (int i = 0; i < 3; i++) {
+            float t1 = (min[i] - origin[i]) * invDirection[i];
+            float t2 = (max[i] - origin[i]) * invDirection[i];
+            if (t1 > t2) { float tmp = t1; t1 = t2; t2 = tmp; }
+            // NaN (origin on a slab with a null direction) keeps the interval untouched
+            if (t1 > tMin) tMin = t1;
+            if (t2 < tMax) tMax = t2;
+            if (tMin > tMax) return false;
+        }
+        return true;
+    }
+};
+
+struct BoundingSphere {
+    glm::vec3 center{0};
+    float radius = 0.f;
+
+    BoundingSphere() = default;
+    BoundingSphere(const glm::vec3 &center, float radius): center(center), radius(radius) {}
+
+    // sphere enclosing this one once transformed. The radius is scaled by a bound of the largest stretch of the
+    // matrix (Gershgorin on its gram matrix), exact when the columns are orthogonal
+    BoundingSphere transformed(const glm::mat4 &matrix) const {
+        glm::vec3 columns[3] = {glm::vec3(matrix[0]), glm::vec3(matrix[1]), glm::vec3(matrix[2])};
+        float stretchSq = 0.f;
+        for (int i = 0; i < 3; i++) {
+            float row = 0.f;
+            for (int j = 0; j < 3; j++) row += glm::abs(glm::dot(columns[i], columns[j]));
+            stretchSq = glm::max(stretchSq, row);
+        }
+        return BoundingSphere(glm::vec3(matrix * glm::vec4(center, 1.f)), radius * glm::sqrt(stretchSq));
+    }
+};
+
+// planes of a view frustum pointing inward, a point p is inside a plane when dot(plane.xyz, p) + plane.w >= 0
+struct Frustum {
+    glm::vec4 planes[6];
+
+    // Gribb-Hartmann extraction, OpenGL clip space (-w <= z <= w)
+    static Frustum fromMatrix(const glm::mat4 &viewProjection) {
+        glm::vec4 rows[4];
+        for (int i = 0; i < 4; i++) rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+        Frustum res;
+        for (int i = 0; i < 3; i++) {
+            res.planes[2 * i] = rows[3] + rows[i];
+            res.planes[2 * i + 1] = rows[3] - rows[i];
+        }
+        for (auto &plane : res.planes) plane /= glm::length(glm::vec3(plane));
+        return res;
+    }
+
+    bool intersects(const BoundingSphere &sphere) const {
+        for (auto &plane : planes) {
+            if (glm::dot(glm::vec3(plane), sphere.center) + plane.w < -sphere.radius) return false;
+        }
+        return true;
+    }
+};
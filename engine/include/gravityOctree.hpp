@@ -0,0 +1,50 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// Barnes-Hut octree over point masses. A cell seen under an angle smaller than theta
+// (cell size / distance < theta) pulls as a single mass at its center of mass, so a field
+// evaluation costs O(log n) instead of summing every source.
+class GravityOctree {
+public:
+    // field = gravitationalConstant * sum(mass * d / (|d|² + softening²)^(3/2))
+    float gravitationalConstant = 1.f;
+    float softening = 0.1f;
+
+    void build(const std::vector<glm::vec3> &positions, const std::vector<float> &masses);
+    void clear();
+
+    bool empty() const { return nodes.empty(); }
+    size_t size() const { return positions.size(); }
+    size_t getNodeCount() const { return nodes.size(); }
+
+    // acceleration at point, theta = 0 opens every cell
+    glm::vec3 field(const glm::vec3 &point, float theta) const;
+    // plain sum over the sources, reference for field()
+    glm::vec3 exactField(const glm::vec3 &point) const;
+
+private:
+    struct Node {
+        glm::vec3 centerOfMass;
+        float mass;
+        glm::vec3 center;
+        float halfSize;
+        uint32_t first; // first child or first source
+        uint32_t count; // children of an inner node, sources of a leaf
+        bool leaf;
+    };
+    static constexpr int MAX_LEAF_SIZE = 4;
+    static constexpr int MAX_DEPTH = 24;
+    // a popped node pushes at most 8 children
+    static constexpr int STACK_SIZE = 7 * MAX_DEPTH + 8;
+
+    std::vector<Node> nodes;
+    // sources in octree order, a node covers a contiguous range
+    std::vector<glm::vec3> positions;
+    std::vector<float> masses;
+
+    glm::vec3 pull(const glm::vec3 &offset, float mass) const;
+};
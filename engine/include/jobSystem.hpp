@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fork/join worker pool shared by the engine systems.
+// parallelFor splits [0, count) into contiguous chunks, chunk i always covers the same
+// range for a given (count, minChunkSize, worker count), so per-chunk outputs merged in
+// chunk order give the same result whatever thread picked them up.
+class JobSystem {
+public:
+    using RangeFunction = std::function<void(size_t begin, size_t end, unsigned chunkIndex)>;
+
+    static JobSystem& getInstance();
+
+    // 1 means everything runs on the calling thread
+    void setWorkerCount(unsigned count);
+    unsigned getWorkerCount() const { return workerCount; }
+
+    unsigned chunkCount(size_t count, size_t minChunkSize) const;
+    void parallelFor(size_t count, size_t minChunkSize, const RangeFunction &fn);
+
+private:
+    JobSystem();
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    void startThreads();
+    void stopThreads();
+    void workerLoop();
+    // job parameters copied under the mutex, the next parallelFor rewrites the members
+    void runChunks(const RangeFunction &fn, size_t count, unsigned chunks);
+
+    unsigned workerCount = 1;
+    std::vector<std::thread> threads;
+
+    std::mutex mutex;
+    std::condition_variable wakeCondition;
+    std::condition_variable doneCondition;
+    uint64_t generation = 0;
+    unsigned activeWorkers = 0;
+    bool stopping = false;
+
+    // one job at a time, a parallelFor from another thread meanwhile runs on its caller
+    std::mutex jobMutex;
+
+    // current job
+    const RangeFunction *job = nullptr;
+    size_t jobCount = 0;
+    unsigned jobChunks = 0;
+    std::atomic<unsigned> nextChunk{0};
+    std::atomic<unsigned> finishedChunks{0};
+};
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <engine/include/geometryHelper.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// Triangles of a mesh collider, in the mesh local space.
+// The bvh is stored depth first with the boxes quantized on 16 bits over the mesh bounds (16 bytes per node),
+// an inner node only keeps the index of the node after its subtree so the traversal needs no stack.
+struct TriangleMeshData {
+    std::vector<glm::vec3> vertices;
+    std::vector<uint32_t> indices; // 3 per triangle, in bvh leaf order
+    Bounds bounds;
+
+    size_t triangleCount() const { return indices.size() / 3; }
+    void getTriangle(uint32_t triangle, glm::vec3 &a, glm::vec3 &b, glm::vec3 &c) const {
+        a = vertices[indices[3 * triangle]];
+        b = vertices[indices[3 * triangle + 1]];
+        c = vertices[indices[3 * triangle + 2]];
+    }
+
+    // builds the bvh from vertices and indices
+    void build();
+
+    // callback(a, b, c) for every triangle whose box overlaps localBounds
+    template<typename Callback>
+    void query(const Bounds &localBounds, Callback callback) const;
+
+    // closest hit of origin + t * direction for t in [0, maxT], -1 if none
+    float raycast(const glm::vec3 &origin, const glm::vec3 &direction, float maxT, glm::vec3 &normal) const;
+
+    // same import as Render::loadSimpleMesh, loaded once per file and layer
+    static TriangleMeshData& loadMesh(const char *directory, const char *fileName, int layer = 0);
+    static TriangleMeshData& fromTriangles(const std::string &key, const std::vector<glm::vec3> &vertices, const std::vector<uint32_t> &indices);
+    static std::map<std::string, TriangleMeshData> meshes;
+
+private:
+    struct Node {
+        uint16_t min[3], max[3];
+        // leaf: LEAF_FLAG | first triangle << 3 | triangle count, inner: index of the node after the subtree
+        uint32_t data;
+    };
+    static constexpr uint32_t LEAF_FLAG = 0x80000000u;
+    static constexpr int MAX_LEAF_SIZE = 4;
+
+    std::vector<Node> nodes;
+    glm::vec3 quantizationScale{0};
+
+    void buildNode(std::vector<uint32_t> &triangles, std::vector<Bounds> &triangleBounds, uint32_t first, uint32_t count);
+    void quantize(const Bounds &box, uint16_t *min, uint16_t *max) const;
+};
+
+// Regular grid of heights over the local xz plane, centered on the origin. Each cell is split in two triangles,
+// the cells under a box are found directly so no tree is needed.
+struct HeightfieldData {
+    int width = 0, depth = 0; // samples along x and z
+    float cellSize = 1.f;
+    std::vector<float> heights; // row major, x first
+    Bounds bounds;
+
+    float height(int x, int z) const { return heights[z * width + x]; }
+    glm::vec3 sample(int x, int z) const {
+        return glm::vec3((x - (width - 1) * 0.5f) * cellSize, height(x, z), (z - (depth - 1) * 0.5f) * cellSize);
+    }
+
+    template<typename Callback>
+    void query(const Bounds &localBounds, Callback callback) const;
+
+    float raycast(const glm::vec3 &origin, const glm::vec3 &direction, float maxT, glm::vec3 &normal) const;
+
+    static HeightfieldData& fromHeights(const std::string &key, int width, int depth, float cellSize, const std::vector<float> &heights);
+    // grey levels of the image scaled to [0, heightScale]
+    static HeightfieldData& loadHeightmap(const char *path, float cellSize, float heightScale);
+    static std::map<std::string, HeightfieldData> heightfields;
+
+private:
+    // cells [x0, x1] x [z0, z1] covering the local box, false if it is outside the grid
+    bool cellRange(const Bounds &localBounds, int &x0, int &x1, int &z0, int &z1) const;
+};
+
+// Möller-Trumbore, t along direction or -1
+float rayTriangleIntersection(const glm::vec3 &origin, const glm::vec3 &direction, const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c, float maxT);
+
+template<typename Callback>
+void TriangleMeshData::query(const Bounds &localBounds, Callback callback) const {
+    if (nodes.empty() || !bounds.overlaps(localBounds)) return;
+
+    uint16_t queryMin[3], queryMax[3];
+    quantize(localBounds, queryMin, queryMax);
+
+    uint32_t index = 0;
+    while (index < nodes.size()) {
+        const Node &node = nodes[index];
+        bool overlap = node.min[0] <= queryMax[0] && node.max[0] >= queryMin[0] &&
+                       node.min[1] <= queryMax[1] && node.max[1] >= queryMin[1] &&
+                       node.min[2] <= queryMax[2] && node.max[2] >= queryMin[2];
+
+        if (node.data & LEAF_FLAG) {
+            if (overlap) {
+                uint32_t first = (node.data & ~LEAF_FLAG) >> 3;
+                uint32_t count = node.data & 7;
+                glm::vec3 a, b, c;
+                for (uint32_t i = first; i < first + count; i++) {
+                    getTriangle(i, a, b, c);
+                    callback(a, b, c);
+                }
+            }
+            index++;
+        } else {
+            index = overlap ? index + 1 : node.data;
+        }
+    }
+}
+
+template<typename Callback>
+void HeightfieldData::query(const Bounds &localBounds, Callback callback) const {
+    int x0, x1, z0, z1;
+    if (!cellRange(localBounds, x0, x1, z0, z1)) return;
+
+    for (int z = z0; z <= z1; z++) {
+        for (int x = x0; x <= x1; x++) {
+            glm::vec3 p00 = sample(x, z), p10 = sample(x + 1, z);
+            glm::vec3 p01 = sample(x, z + 1), p11 = sample(x + 1, z + 1);
+            // skip the cell if the box is entirely above or below it
+            float low = std::min(std::min(p00.y, p10.y), std::min(p01.y, p11.y));
+            float high = std::max(std::max(p00.y, p10.y), std::max(p01.y, p11.y));
+            if (low > localBounds.max.y || high < localBounds.min.y) continue;
+
+            // counter clockwise seen from above, normals up
+            callback(p00, p01, p11);
+            callback(p00, p11, p10);
+        }
+    }
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <engine/include/ecs/base/entity.hpp>
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class Transform;
+
+// Fixed size ring for one producer thread and one consumer thread, no lock.
+template<typename T, size_t CAPACITY>
+class SpscQueue {
+public:
+    // false when full
+    bool push(const T &item) {
+        size_t current = tail.load(std::memory_order_relaxed);
+        size_t next = (current + 1) % CAPACITY;
+        if (next == head.load(std::memory_order_acquire)) return false;
+        items[current] = item;
+        tail.store(next, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T &item) {
+        size_t current = head.load(std::memory_order_relaxed);
+        if (current == tail.load(std::memory_order_acquire)) return false;
+        item = items[current];
+        head.store((current + 1) % CAPACITY, std::memory_order_release);
+        return true;
+    }
+
+private:
+    std::array<T, CAPACITY> items;
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) std::atomic<size_t> tail{0};
+};
+
+// Gameplay request on a rigid body, applied at the start of the next physic step
+struct PhysicCommand {
+    enum Type {
+        ADD_FORCE,   // over one step
+        ADD_IMPULSE, // velocity change, as RigidBody::addLinearImpulse
+        SET_VELOCITY,
+        SET_POSITION // teleport, not interpolated from the old position
+    };
+    Type type;
+    Entity entity;
+    glm::vec3 value;
+};
+
+// Runs the physic steps on a dedicated thread so the frame renders while they run.
+// Between kick() and wait() the job owns the rigid bodies, the collision shapes and the transforms of
+// the moving bodies and their children: the renderer reads those transforms from the poses published
+// before the kick, gameplay talks to the bodies through the command queue.
+class PhysicThread {
+public:
+    static PhysicThread& getInstance();
+
+    void kick(std::function<void()> job);
+    // blocks until the kicked job is done, the poses are dropped so the renderer reads the transforms again
+    void wait();
+    bool isBusy();
+
+    // main thread, job idle: copies the model matrices the renderer uses until the next wait()
+    void publishPoses(const std::vector<Transform*> &transforms);
+    // false if the transform isn't moved by the running job
+    bool getPose(const Transform *transform, glm::mat4 &matrix) const;
+
+    // false when the queue is full, the command is then dropped
+    bool push(const PhysicCommand &command);
+    // physic side, before each step
+    void applyCommands(float deltaTime);
+
+private:
+    PhysicThread() = default;
+    ~PhysicThread();
+
+    PhysicThread(const PhysicThread&) = delete;
+    PhysicThread& operator=(const PhysicThread&) = delete;
+
+    void threadLoop();
+    void waitIdle();
+
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable kickCondition;
+    std::condition_variable doneCondition;
+    std::function<void()> job;
+    bool busy = false;
+    bool stopping = false;
+
+    std::unordered_map<const Transform*, uint32_t> poseSlots;
+    std::vector<glm::mat4> poses;
+
+    SpscQueue<PhysicCommand, 1024> commands;
+};
@@ -3,11 +3,17 @@
 #include <vector>
 #include <map>
 #include <memory>
+#include <string>
+#include <unordered_map>
 
 #include <engine/include/ecs/implementations/components.hpp>
 class Drawable;
 
 class Material;
+class Program;
+
+// index of a reflected uniform in its Program, -1 when the program doesn't have it (setting it does nothing)
+typedef int UniformHandle;
 
 struct Texture {
     const char *path;
@@ -27,7 +33,8 @@ struct Texture {
 
     static Texture emptyTexture;
     
-    void activate(GLuint textureLocation);
+    // on the next free unit, the sampler is of the program in use
+    void activate(Program &program, UniformHandle sampler);
     static int getAvailableActivationInt();
     static void resetActivationInt();
 
@@ -44,13 +51,60 @@ struct Cubemap {
     void clear();
 };
 
+// Data of the view being drawn, in one std140 uniform block bound at BINDING that every program reads as
+// CameraBlock. Set once per view, the programs then only receive their per object uniforms.
+class CameraUniforms {
+    public:
+    static const GLuint BINDING = 0;
+
+    // uploads the whole block
+    static void set(const glm::mat4 &view, const glm::mat4 &projection);
+    // sent with the next set
+    static void setTime(float time);
+
+    static const glm::mat4& getView() { return block.v; }
+    static const glm::mat4& getProjection() { return block.p; }
+    static glm::vec3 getPosition() { return glm::vec3(block.cameraPosition); }
+    static void clear();
+
+    private:
+    // same layout as the GLSL block
+    struct Block {
+        glm::mat4 v;
+        glm::mat4 p;
+        glm::vec4 cameraPosition;
+        float time;
+        float padding[3];
+    };
+    static Block block;
+    static GLuint buffer;
+};
+
+// Active uniform of a linked program. The last value sent is kept so sending it again is skipped.
+struct Uniform {
+    GLint location = -1;
+    GLenum type = 0;
+    bool sampler = false;
+    bool sent = false;
+    unsigned char value[sizeof(glm::mat4)];
+};
+
 class Program {
     private:
-    GLuint modelLocation, vLocation, pLocation;
+    UniformHandle modelUniform = -1;
+    // arrays have one uniform per element, "name[i]", "name" is the first one
+    std::vector<Uniform> uniforms;
+    std::unordered_map<std::string, UniformHandle> uniformHandles;
+    std::unordered_map<std::string, GLuint> uniformBlocks;
+
+    // at link time, the only place that queries the locations
+    void reflect();
+    // false when the handle is -1 or the uniform already holds the value
+    bool changed(UniformHandle handle, const void *value, size_t size);
 
     protected:
     // Setup à l'initialisation uniquement
-    std::map<GLuint, Texture*> programTextures;
+    std::map<UniformHandle, Texture*> programTextures;
     
     public:
     GLuint programID;
@@ -67,9 +121,21 @@ class Program {
     void initTexture(char *path, char *uniformName);
     virtual void updateGUI();
 
-    void updateViewMatrix(glm::mat4 &v);
-    void updateProjectionMatrix(glm::mat4 &p);
-    void updateModelMatrix(glm::mat4 model);
+    void updateModelMatrix(const glm::mat4 &model);
+
+    // lookups, to do once and keep the handle
+    UniformHandle getUniform(const std::string &name) const;
+    // handles of name[0], name[1]... up to the last element the linker kept
+    std::vector<UniformHandle> getUniformArray(const std::string &name) const;
+    // GL_INVALID_INDEX when the program has no such block
+    GLuint getUniformBlock(const std::string &name) const;
+
+    // on the program in use
+    void set(UniformHandle handle, int value);
+    void set(UniformHandle handle, float value);
+    void set(UniformHandle handle, const glm::vec3 &value);
+    void set(UniformHandle handle, const glm::vec4 &value);
+    void set(UniformHandle handle, const glm::mat4 &value);
 
     void updateLightCount(int count);
     void updateLightPosition(int lightIndex, glm::vec3 position);
@@ -78,17 +144,20 @@ class Program {
     void use() {
         glUseProgram(programID);
     }
-    void setFloat(char* uniformName,float valeur){
-        glUniform1f(glGetUniformLocation(programID,uniformName),valeur);
+    void setFloat(const std::string &uniformName,float valeur){
+        set(getUniform(uniformName), valeur);
     }
-    void setInt(const std::string &name, int value) const
+    void setInt(const std::string &name, int value)
     { 
-        glUniform1i(glGetUniformLocation(programID, name.c_str()), value); 
+        set(getUniform(name), value); 
     }
     static void destroyPrograms();
 };
 
 class Skybox: public Program{
+    private:
+    UniformHandle skyboxUniform;
+
     public:
     Cubemap cubemap;
     Skybox(Cubemap sky);
@@ -113,6 +182,9 @@ class BrdfShader:public Program{
 };
 
 class CubemapProg: public Program {
+    private:
+    UniformHandle skyboxUniform;
+
     public:
     GLuint textureID;
 
@@ -123,19 +195,32 @@ class CubemapProg: public Program {
 
 class PBR: public Program{
     private:
-    GLuint albedoLocation, metallicLocation, roughnessLocation, aoLocation, hasTextureLocation, indensiteScaleLightLocation;
-    GLuint albedoTexLocation, metallicTexLocation, roughnessTexLocation, aoTexLocation, normalTexLocation;
-    GLuint hasAlbedoMapLocation, hasNormalMapLocation, hasMetallicMapLocation, hasRoughnessMapLocation, hasAoMapLocation;
+    UniformHandle albedoUniform, metallicUniform, roughnessUniform, aoUniform, hasTextureUniform, indensiteScaleLightUniform;
+    UniformHandle albedoTexUniform, metallicTexUniform, roughnessTexUniform, aoTexUniform, normalTexUniform;
+    UniformHandle hasAlbedoMapUniform, hasNormalMapUniform, hasMetallicMapUniform, hasRoughnessMapUniform, hasAoMapUniform;
+    UniformHandle instancedUniform, lightCountUniform;
+    UniformHandle irradianceMapUniform, prefilterMapUniform, brdfLUTMapUniform;
+    UniformHandle bonePaletteUniform, boneOffsetUniform;
+    // one per element of the arrays the linker kept
+    std::vector<UniformHandle> lightPositionUniforms, lightColorUniforms;
     
 
     public:
     PBR();
     void updateGUI() override;
     void updateMaterial(Material &value);
+    // model matrices from the instance attribute (location 5) instead of the model uniform
+    void setInstanced(bool value);
 
     void updateLightCount(int count);
     void updateLightPosition(int lightIndex, glm::vec3 position);
     void updateLightColor(int lightIndex, glm::vec3 color);
+    // texture units of the image based lighting maps
+    void updateEnvironmentMaps(int irradianceUnit, int prefilterUnit, int brdfLUTUnit);
+    // texture unit of the bone palette buffer texture
+    void updateBonePalette(int unit);
+    // in matrices, first bone of the drawn skinned drawable in the palette
+    void updateBoneOffset(int offset);
     
 };
 
@@ -3,6 +3,7 @@
 #include <engine/include/input.hpp>
 #include <engine/include/ecs/ecsManager.hpp>
 #include <engine/include/ecs/implementations/systems.hpp>
+#include <engine/include/physicThread.hpp>
 
 
 #include <iostream>
@@ -57,12 +58,17 @@ Entity generatePlanetBody(ecsManager &ecs, glm::vec3 position, float radius){
     // sphereMaterial.roughnessTex = &Texture::loadTexture("../assets/images/PBR/woods/Roughness.jpg");
     // sphereMaterial.aoTex = &Texture::loadTexture("../assets/images/PBR/woods/AO.jpg");
 
+    // about 9.81 at the surface with the default gravitational constant
+    GravitySource gravitySource;
+    gravitySource.mass = 9.81f * radius * radius;
+
     Transform sphereTransform;
     sphereTransform.translate(position);
 
     ecs.AddComponent(sphereEntity, sphereTransform);
     ecs.AddComponent(sphereEntity, sphereRigidBody);
     ecs.AddComponent(sphereEntity, sphereCollisionShape);
+    ecs.AddComponent(sphereEntity, gravitySource);
 
     return sphereEntity;
 }
@@ -117,7 +123,7 @@ Entity generateCrate(ecsManager &ecs, glm::vec3 position){
 }
 
 
-Entity generateEgg(ecsManager &ecs, SpatialNode *parent, glm::vec3 position){
+Entity generateEgg(ecsManager &ecs, SceneGraph &scene, glm::vec3 position, Entity parent = SceneGraph::ROOT){
     auto eggEntity = ecs.CreateEntity();
     Transform eggTransform;
     CollisionShape eggShape;
@@ -149,13 +155,12 @@ Entity generateEgg(ecsManager &ecs, SpatialNode *parent, glm::vec3 position){
     ecs.AddComponent(eggMeshEntity, eggMaterial);
     
     
-    std::unique_ptr<SpatialNode> eggNode = std::make_unique<SpatialNode>(&ecs.GetComponent<Transform>(eggEntity));
-    eggNode->AddChild(std::make_unique<SpatialNode>(&ecs.GetComponent<Transform>(eggMeshEntity)));
-    parent->AddChild(std::move(eggNode));
+    scene.add(eggEntity, parent);
+    scene.add(eggMeshEntity, eggEntity);
     return eggEntity;
 }
 
-Entity generatePlayer(ecsManager &ecs, SpatialNode &parent){
+Entity generatePlayer(ecsManager &ecs, SceneGraph &scene, Entity parent = SceneGraph::ROOT){
     // Ground check
     auto groundCheckEntity = ecs.CreateEntity();
     Transform rayTransform;
@@ -275,16 +280,13 @@ Entity generatePlayer(ecsManager &ecs, SpatialNode &parent){
 
 
 
-    std::unique_ptr<SpatialNode> playerNode = std::make_unique<SpatialNode>(&ecs.GetComponent<Transform>(playerEntity));
-    std::unique_ptr<SpatialNode> rayNode = std::make_unique<SpatialNode>(&ecs.GetComponent<Transform>(groundCheckEntity));
-
-    playerNode->AddChild(std::move(rayNode));
-    parent.AddChild(std::move(playerNode));
+    scene.add(playerEntity, parent);
+    scene.add(groundCheckEntity, playerEntity);
 
     return playerEntity;
 }
 
-Entity generateWall(ecsManager &ecs, SpatialNode *parent){
+Entity generateWall(ecsManager &ecs, SceneGraph &scene, Entity parent = SceneGraph::ROOT){
     auto wallEntity = ecs.CreateEntity();
     Material wallMat;
     wallMat.albedoTex = &Texture::loadTexture("../assets/images/wall/blockPieceTex.png");
@@ -315,14 +317,13 @@ Entity generateWall(ecsManager &ecs, SpatialNode *parent){
     ecs.AddComponent(wallEntity, wallDrawable);
     ecs.AddComponent(wallEntity, wallMat);
 
-    std::unique_ptr<SpatialNode> wallNode = std::make_unique<SpatialNode>(&ecs.GetComponent<Transform>(wallEntity));
-    parent->AddChild(std::move(wallNode));
+    scene.add(wallEntity, parent);
 
     return wallEntity;
 }
 
 
-Entity generateSingleTunnel(ecsManager &ecs, SpatialNode &parent, Entity &interactionEntity){
+Entity generateSingleTunnel(ecsManager &ecs, SceneGraph &scene, Entity parent = SceneGraph::ROOT){
     Entity tunnel = ecs.CreateEntity();
     Transform tunnelTransform;
     Drawable tunnelDrawable;
@@ -335,71 +336,80 @@ Entity generateSingleTunnel(ecsManager &ecs, SpatialNode &parent, Entity &intera
     tunnelMaterial.albedoTex->visible = false;
     tunnelMaterial.albedo = glm::vec3(0.3, 1, 0.2);
     tunnelBody.type = RigidBody::STATIC;
-    tunnelShape.shapeType = OOBB;
-    tunnelShape.oobb.halfExtents = {1.1, 1.9,1.1};
-    
-    ecs.AddComponent(tunnel, tunnelTransform);
-    ecs.AddComponent(tunnel, tunnelDrawable);
-    ecs.AddComponent(tunnel, tunnelMaterial);
-    ecs.AddComponent(tunnel, tunnelBody);
-    ecs.AddComponent(tunnel, tunnelShape);
-
 
-    interactionEntity = ecs.CreateEntity();
-    Transform interactionTransform;
+    // the four walls of the pipe and its cap, the sphere above it reports the player
+    CompoundShapeData &tunnelData = CompoundShapeData::create("tunnel");
+    const glm::vec3 walls[5][2] = {
+        {{ 1.0f, 0.f,  0.f}, {0.1f, 1.9f, 1.1f}},
+        {{-1.0f, 0.f,  0.f}, {0.1f, 1.9f, 1.1f}},
+        {{ 0.f,  0.f,  1.0f}, {0.9f, 1.9f, 0.1f}},
+        {{ 0.f,  0.f, -1.0f}, {0.9f, 1.9f, 0.1f}},
+        {{ 0.f,  1.8f, 0.f}, {0.9f, 0.1f, 0.9f}}
+    };
+    for(auto &wall: walls){
+        CollisionShape wallShape;
+        wallShape.shapeType = OOBB;
+        wallShape.oobb.halfExtents = wall[1];
+        tunnelData.addChild(std::move(wallShape), wall[0]);
+    }
     CollisionShape interactionShape;
-
-    interactionTransform.translate({0,3,0});
     interactionShape.shapeType = SPHERE;
     interactionShape.sphere.radius = 0.75f;
-    interactionShape.layer = 0;
     interactionShape.mask = CollisionShape::PLAYER_LAYER;
+    tunnelData.addTrigger(std::move(interactionShape), {0,3,0});
+    tunnelData.build();
 
-    ecs.AddComponent(interactionEntity, interactionTransform);
-    ecs.AddComponent(interactionEntity, interactionShape);
-
-    std::unique_ptr<SpatialNode> tunnelNode = std::make_unique<SpatialNode>(&ecs.GetComponent<Transform>(tunnel));
-    std::unique_ptr<SpatialNode> interactionNode = std::make_unique<SpatialNode>(&ecs.GetComponent<Transform>(interactionEntity));
+    tunnelShape.shapeType = COMPOUND;
+    tunnelShape.compound.data = &tunnelData;
+    // the walls only push, the player is reported by the trigger
+    tunnelShape.mask = 0;
+    
+    ecs.AddComponent(tunnel, tunnelTransform);
+    ecs.AddComponent(tunnel, tunnelDrawable);
+    ecs.AddComponent(tunnel, tunnelMaterial);
+    ecs.AddComponent(tunnel, tunnelBody);
+    ecs.AddComponent(tunnel, tunnelShape);
 
-    tunnelNode->AddChild(std::move(interactionNode));
-    parent.AddChild(std::move(tunnelNode));
+    scene.add(tunnel, parent);
     return tunnel;
 }
-void generateTunnels(ecsManager &ecs, SpatialNode &parent, Entity &playerEntity, Entity &tunnelA, Entity &tunnelB){
-    Entity interactionA, interactionB;
-    tunnelA = generateSingleTunnel(ecs, parent, interactionA);
-    tunnelB = generateSingleTunnel(ecs, parent, interactionB);
+void generateTunnels(ecsManager &ecs, SceneGraph &scene, Entity &playerEntity, Entity &tunnelA, Entity &tunnelB){
+    tunnelA = generateSingleTunnel(ecs, scene);
+    tunnelB = generateSingleTunnel(ecs, scene);
+
+    // arrives on top of the other pipe, where its trigger is; the physic step moves the body
+    auto teleport = [playerEntity, &ecs](Entity destination){
+        Transform &playerTransform = ecs.GetComponent<Transform>(playerEntity);
+        glm::vec3 arrival = glm::vec3(ecs.GetComponent<Transform>(destination).getModelMatrix() * glm::vec4(0, 3, 0, 1));
+        glm::vec3 target = playerTransform.getLocalPosition() + arrival - playerTransform.getGlobalPosition();
+        if(ecs.HasComponent<RigidBody>(playerEntity) && PhysicThread::getInstance().push({PhysicCommand::SET_POSITION, playerEntity, target})) return;
+        playerTransform.setLocalPosition(target);
+    };
 
     CustomBehavior behaviorA;
-    behaviorA.update = [interactionA, interactionB, playerEntity, &ecs](float delta) {
+    behaviorA.update = [tunnelA, tunnelB, playerEntity, teleport, &ecs](float delta) {
         auto actions = InputManager::getInstance().getActions();
         
-        auto &collisionA = ecs.GetComponent<CollisionShape>(interactionA);
-        if(collisionA.isAnythingColliding() && actions[InputManager::ACTION_INTERACT].clicked){
-            Transform &playerTransform = ecs.GetComponent<Transform>(playerEntity);
-            Transform &interactionBTransform = ecs.GetComponent<Transform>(interactionB);
-            
-            playerTransform.translate(interactionBTransform.getGlobalPosition() - playerTransform.getGlobalPosition());
+        auto &collisionA = ecs.GetComponent<CollisionShape>(tunnelA);
+        if(collisionA.isColliding(playerEntity) && actions[InputManager::ACTION_INTERACT].clicked){
+            teleport(tunnelB);
         }
     };
     ecs.AddComponent(tunnelA, behaviorA);
 
 
     CustomBehavior behaviorB;
-    behaviorB.update = [interactionA, interactionB, playerEntity, &ecs](float delta) {
+    behaviorB.update = [tunnelA, tunnelB, playerEntity, teleport, &ecs](float delta) {
         auto actions = InputManager::getInstance().getActions();
         
-        if(ecs.GetComponent<CollisionShape>(interactionB).isAnythingColliding() && actions[InputManager::ACTION_INTERACT].clicked){
-            Transform &playerTransform = ecs.GetComponent<Transform>(playerEntity);
-            Transform &interactionATransform = ecs.GetComponent<Transform>(interactionA);
-            
-            playerTransform.translate(interactionATransform.getGlobalPosition() - playerTransform.getGlobalPosition());
+        if(ecs.GetComponent<CollisionShape>(tunnelB).isColliding(playerEntity) && actions[InputManager::ACTION_INTERACT].clicked){
+            teleport(tunnelA);
         }
     };
     ecs.AddComponent(tunnelB, behaviorB);
 }
 
-Entity generateLevel1(SpatialNode &root, ecsManager &ecs, Entity &playerEntity){
+Entity generateLevel1(SceneGraph &scene, ecsManager &ecs, Entity &playerEntity){
     Entity levelCameraEntity = ecs.CreateEntity();
     Transform cameraTransform;
     cameraTransform.translate({0, 5, -15});
@@ -437,37 +447,34 @@ Entity generateLevel1(SpatialNode &root, ecsManager &ecs, Entity &playerEntity){
     Entity light1 = createLightSource(ecs, {-195,-195,-200}, {1,1,1});
     ecs.SetEntityName(light1, "Light 1");
 
-    std::unique_ptr<SpatialNode> levelNode = std::make_unique<SpatialNode>(&ecs.GetComponent<Transform>(level));
-    levelNode->AddChild(std::make_unique<SpatialNode>(&ecs.GetComponent<Transform>(levelCameraEntity)));
-    levelNode->AddChild(std::make_unique<SpatialNode>(&ecs.GetComponent<Transform>(light1)));
+    scene.add(level);
+    scene.add(levelCameraEntity, level);
+    scene.add(light1, level);
 
     
-    Entity wall1 = generateWall(ecs, levelNode.get());
+    Entity wall1 = generateWall(ecs, scene, level);
     ecs.GetComponent<Transform>(wall1).rotate({180,0,0});
     ecs.GetComponent<Transform>(wall1).translate({0,10,0});
-    Entity wall2 = generateWall(ecs, levelNode.get());
+    Entity wall2 = generateWall(ecs, scene, level);
     ecs.GetComponent<Transform>(wall2).rotate({-90,0,0});
     ecs.GetComponent<Transform>(wall2).translate({0,5,5});
-    Entity wall3 = generateWall(ecs, levelNode.get());
+    Entity wall3 = generateWall(ecs, scene, level);
     ecs.GetComponent<Transform>(wall3).rotate({0,0,90});
     ecs.GetComponent<Transform>(wall3).translate({5,5,0});
-    Entity wall4 = generateWall(ecs, levelNode.get());
+    Entity wall4 = generateWall(ecs, scene, level);
     ecs.GetComponent<Transform>(wall4).rotate({0,0,-90});
     ecs.GetComponent<Transform>(wall4).translate({-5,5,0});
-    Entity wall5 = generateWall(ecs, levelNode.get());
+    Entity wall5 = generateWall(ecs, scene, level);
 
 
 
     // levelCamComp.needActivation = true;
 
 
-    
-    root.AddChild(std::move(levelNode));
-
     return level;
 }
 
-Entity loadMeshLayer(SpatialNode &parent, ecsManager &ecs, char* folderPath, char* fileName, int layer){
+Entity loadMeshLayer(SceneGraph &scene, Entity parent, ecsManager &ecs, char* folderPath, char* fileName, int layer){
     auto res = ecs.CreateEntity();
     Transform layer1Transform;
     Drawable sphereDraw;
@@ -478,14 +485,13 @@ Entity loadMeshLayer(SpatialNode &parent, ecsManager &ecs, char* folderPath, cha
     ecs.AddComponent(res, sphereMaterial);
 
 
-    std::unique_ptr<SpatialNode> meshNode = std::make_unique<SpatialNode>(&ecs.GetComponent<Transform>(res));
-    parent.AddChild(std::move(meshNode));
+    scene.add(res, parent);
 
 
     return res;
 }
 
-Entity generatePlanet1(SpatialNode &root, ecsManager &ecs, Entity &playerEntity, glm::vec3 planetCenter){
+Entity generatePlanet1(SceneGraph &scene, ecsManager &ecs, Entity &playerEntity, glm::vec3 planetCenter){
     auto planetEntity = generatePlanetBody(ecs, planetCenter, 23.f);
     ecs.SetEntityName(planetEntity, "Planet 1");
     auto planetGravity = generateGravityArea(ecs, glm::vec3(0.f), 30.f, playerEntity);
@@ -499,23 +505,23 @@ Entity generatePlanet1(SpatialNode &root, ecsManager &ecs, Entity &playerEntity,
 
 
 
-    std::unique_ptr<SpatialNode> planetNode = std::make_unique<SpatialNode>(&ecs.GetComponent<Transform>(planetEntity));
-    std::unique_ptr<SpatialNode> planetGravityNode = std::make_unique<SpatialNode>(&ecs.GetComponent<Transform>(planetGravity));
-    std::unique_ptr<SpatialNode> drawingNode = std::make_unique<SpatialNode>(&ecs.GetComponent<Transform>(drawingNodeEntity));
+    scene.add(planetEntity);
+    scene.add(planetGravity, planetEntity);
+    scene.add(drawingNodeEntity, planetEntity);
 
 
     Entity currentEntity;
-    currentEntity = loadMeshLayer(*drawingNode.get(), ecs, "../assets/meshes/Props", "/planet_1.glb", 0);
+    currentEntity = loadMeshLayer(scene, drawingNodeEntity, ecs, "../assets/meshes/Props", "/planet_1.glb", 0);
     ecs.GetComponent<Drawable>(currentEntity).hideOnCubemapRender = true;
-    currentEntity = loadMeshLayer(*drawingNode.get(), ecs, "../assets/meshes/Props", "/planet_1.glb", 2);
+    currentEntity = loadMeshLayer(scene, drawingNodeEntity, ecs, "../assets/meshes/Props", "/planet_1.glb", 2);
     ecs.GetComponent<Drawable>(currentEntity).hideOnCubemapRender = true;
-    currentEntity = loadMeshLayer(*drawingNode.get(), ecs, "../assets/meshes/Props", "/planet_1.glb", 4);
+    currentEntity = loadMeshLayer(scene, drawingNodeEntity, ecs, "../assets/meshes/Props", "/planet_1.glb", 4);
     ecs.GetComponent<Drawable>(currentEntity).hideOnCubemapRender = true;
-    currentEntity = loadMeshLayer(*drawingNode.get(), ecs, "../assets/meshes/Props", "/planet_1.glb", 8);
+    currentEntity = loadMeshLayer(scene, drawingNodeEntity, ecs, "../assets/meshes/Props", "/planet_1.glb", 8);
     ecs.GetComponent<Drawable>(currentEntity).hideOnCubemapRender = true;
-    currentEntity = loadMeshLayer(*drawingNode.get(), ecs, "../assets/meshes/Props", "/planet_1.glb", 10);
+    currentEntity = loadMeshLayer(scene, drawingNodeEntity, ecs, "../assets/meshes/Props", "/planet_1.glb", 10);
     ecs.GetComponent<Drawable>(currentEntity).hideOnCubemapRender = true;
-    currentEntity = loadMeshLayer(*drawingNode.get(), ecs, "../assets/meshes/Props", "/planet_1.glb", 6);
+    currentEntity = loadMeshLayer(scene, drawingNodeEntity, ecs, "../assets/meshes/Props", "/planet_1.glb", 6);
     ecs.GetComponent<Drawable>(currentEntity).hideOnCubemapRender = true;
 
     float lightDistance = 30.f;
@@ -527,14 +533,11 @@ Entity generatePlanet1(SpatialNode &root, ecsManager &ecs, Entity &playerEntity,
     createLightSource(ecs, planetCenter + glm::vec3(0,lightDistance,0), {1,0.5,0.25});
     createLightSource(ecs, planetCenter + glm::vec3(0,-lightDistance,0), {1,0.5,0.25});
 
-    planetNode->AddChild(std::move(planetGravityNode));
-    planetNode->AddChild(std::move(drawingNode));
-    root.AddChild(std::move(planetNode));
 
     return planetEntity;
 }
 
-Entity generatePlanet2(SpatialNode &root, ecsManager &ecs, Entity &playerEntity, glm::vec3 planetCenter){
+Entity generatePlanet2(SceneGraph &scene, ecsManager &ecs, Entity &playerEntity, glm::vec3 planetCenter){
     auto planetEntity = generatePlanetBody(ecs, planetCenter, 10.f);
     ecs.SetEntityName(planetEntity, "Planet 2");
     auto planetGravity = generateGravityArea(ecs, glm::vec3(0.f), 20.f, playerEntity);
@@ -548,17 +551,17 @@ Entity generatePlanet2(SpatialNode &root, ecsManager &ecs, Entity &playerEntity,
 
 
 
-    std::unique_ptr<SpatialNode> planetNode = std::make_unique<SpatialNode>(&ecs.GetComponent<Transform>(planetEntity));
-    std::unique_ptr<SpatialNode> planetGravityNode = std::make_unique<SpatialNode>(&ecs.GetComponent<Transform>(planetGravity));
-    std::unique_ptr<SpatialNode> drawingNode = std::make_unique<SpatialNode>(&ecs.GetComponent<Transform>(drawingNodeEntity));
+    scene.add(planetEntity);
+    scene.add(planetGravity, planetEntity);
+    scene.add(drawingNodeEntity, planetEntity);
 
 
-    loadMeshLayer(*drawingNode.get(), ecs, "../assets/meshes/Props", "/planet_1.glb", 0);
-    loadMeshLayer(*drawingNode.get(), ecs, "../assets/meshes/Props", "/planet_1.glb", 2);
-    loadMeshLayer(*drawingNode.get(), ecs, "../assets/meshes/Props", "/planet_1.glb", 4);
-    loadMeshLayer(*drawingNode.get(), ecs, "../assets/meshes/Props", "/planet_1.glb", 8);
-    loadMeshLayer(*drawingNode.get(), ecs, "../assets/meshes/Props", "/planet_1.glb", 10);
-    loadMeshLayer(*drawingNode.get(), ecs, "../assets/meshes/Props", "/planet_1.glb", 6);
+    loadMeshLayer(scene, drawingNodeEntity, ecs, "../assets/meshes/Props", "/planet_1.glb", 0);
+    loadMeshLayer(scene, drawingNodeEntity, ecs, "../assets/meshes/Props", "/planet_1.glb", 2);
+    loadMeshLayer(scene, drawingNodeEntity, ecs, "../assets/meshes/Props", "/planet_1.glb", 4);
+    loadMeshLayer(scene, drawingNodeEntity, ecs, "../assets/meshes/Props", "/planet_1.glb", 8);
+    loadMeshLayer(scene, drawingNodeEntity, ecs, "../assets/meshes/Props", "/planet_1.glb", 10);
+    loadMeshLayer(scene, drawingNodeEntity, ecs, "../assets/meshes/Props", "/planet_1.glb", 6);
 
     
     float lightDistance = 20.f;
@@ -569,25 +572,22 @@ Entity generatePlanet2(SpatialNode &root, ecsManager &ecs, Entity &playerEntity,
     createLightSource(ecs, planetCenter + glm::vec3(0,0,-lightDistance), {1,1,1});
 
 
-    planetNode->AddChild(std::move(planetGravityNode));
-    planetNode->AddChild(std::move(drawingNode));
-    root.AddChild(std::move(planetNode));
 
     return planetEntity;
 }
 
-void initScene(SpatialNode &root, ecsManager &ecs){
+void initScene(SceneGraph &scene, ecsManager &ecs){
     Program::programs.push_back(std::make_unique<PBR>());    
 
-    Entity playerEntity = generatePlayer(ecs, root);
+    Entity playerEntity = generatePlayer(ecs, scene);
 
 
-    Entity levelEntity = generateLevel1(root, ecs, playerEntity);
+    Entity levelEntity = generateLevel1(scene, ecs, playerEntity);
     ecs.GetComponent<Transform>(levelEntity).translate({-200,-200,-200});
 
     Entity tunnelA, tunnelB,tunnelC, tunnelD;
-    generateTunnels(ecs, root, playerEntity, tunnelA, tunnelB);
-    generateTunnels(ecs, root, playerEntity, tunnelC, tunnelD);
+    generateTunnels(ecs, scene, playerEntity, tunnelA, tunnelB);
+    generateTunnels(ecs, scene, playerEntity, tunnelC, tunnelD);
 
 
     // ecs.GetComponent<Transform>(tunnelA).translate({0,12,6});
@@ -604,10 +604,16 @@ void initScene(SpatialNode &root, ecsManager &ecs){
 
 
     glm::vec3 planetCenter = {14, 0, 14};
-    generatePlanet1(root, ecs, playerEntity, planetCenter);
+    generatePlanet1(scene, ecs, playerEntity, planetCenter);
 
     glm::vec3 planetCenter2 = {80, 80, 80};
-    generatePlanet2(root, ecs, playerEntity, planetCenter2);
+    generatePlanet2(scene, ecs, playerEntity, planetCenter2);
+
+    // pulled by both planets through the gravity field instead of a gravity area
+    auto fieldCrate = generateCrate(ecs, (planetCenter + planetCenter2) * 0.5f);
+    ecs.SetEntityName(fieldCrate, "Field crate");
+    ecs.GetComponent<RigidBody>(fieldCrate).useGravityField = true;
+    scene.add(fieldCrate);
     // auto planetEntity = generatePlanetBody(ecs, planetCenter, 20.f);
     // auto planetGravity = generateGravityArea(ecs, glm::vec3(0.f), 60.f, playerEntity);
 
@@ -631,8 +637,8 @@ void initScene(SpatialNode &root, ecsManager &ecs){
     // auto crateEntity2 = generateCrate(ecs, {0,35, 0});
     // ecs.SetEntityName(crateEntity2, "crate2");
 
-    // root.AddChild(std::make_unique<SpatialNode>(&ecs.GetComponent<Transform>(crateEntity)));
-    // root.AddChild(std::make_unique<SpatialNode>(&ecs.GetComponent<Transform>(crateEntity2)));
+    // scene.add(crateEntity);
+    // scene.add(crateEntity2);
     
 
     
@@ -697,24 +703,19 @@ void initScene(SpatialNode &root, ecsManager &ecs){
     auto rootEntity = ecs.CreateEntity();
     Transform rootTransform;
     ecs.AddComponent(rootEntity, rootTransform);
-    root.transform = &ecs.GetComponent<Transform>(rootEntity);
+    scene.setRoot(rootEntity);
     
-    std::unique_ptr<SpatialNode> playerCameraNode = std::make_unique<SpatialNode>(&ecs.GetComponent<Transform>(cameraEntity));
-    // std::unique_ptr<SpatialNode> b1Node = std::make_unique<SpatialNode>(&ecs.GetComponent<Transform>(b1Entity));
-    // std::unique_ptr<SpatialNode> b2Node = std::make_unique<SpatialNode>(&ecs.GetComponent<Transform>(b2Entity));
-    // std::unique_ptr<SpatialNode> otherNode = std::make_unique<SpatialNode>(&ecs.GetComponent<Transform>(otherEntity));
-
-    root.AddChild(std::move(playerCameraNode));
-    // root.AddChild(std::move(otherNode));
-    // root.AddChild(std::move(b1Node));
-    // root.AddChild(std::move(b2Node));
+    scene.add(cameraEntity);
+    // scene.add(otherEntity);
+    // scene.add(b1Entity);
+    // scene.add(b2Entity);
 }
 
 
 
 
 float totalTime = 0;
-void pbrScene(SpatialNode &root, ecsManager &ecs){
+void pbrScene(SceneGraph &scene, ecsManager &ecs){
     auto cameraEntity = ecs.CreateEntity();
     CustomBehavior cameraUpdate;
     cameraUpdate.update = [](float deltaTime){
@@ -746,19 +747,18 @@ void pbrScene(SpatialNode &root, ecsManager &ecs){
     auto rootEntity = ecs.CreateEntity();
     Transform rootTransform;
     ecs.AddComponent(rootEntity, rootTransform);
-    root.transform = &ecs.GetComponent<Transform>(rootEntity);
+    scene.setRoot(rootEntity);
 
     CustomBehavior continuousRotation;
-    continuousRotation.update = [&root](float deltaTime){
-        root.transform->rotate(glm::vec3(0, deltaTime * 10.f, 0));
+    continuousRotation.update = [rootEntity, &ecs](float deltaTime){
+        ecs.GetComponent<Transform>(rootEntity).rotate(glm::vec3(0, deltaTime * 10.f, 0));
     };
     ecs.AddComponent(rootEntity, continuousRotation);
 
     Program::programs.push_back(std::make_unique<PBR>());
     for(int i=0; i<5; i++){
         auto ent = generateSpherePBR(ecs, 0.75f, glm::vec3(-5 + i*2, 0, 0));
-        std::unique_ptr<SpatialNode> sphereNode = std::make_unique<SpatialNode>(&ecs.GetComponent<Transform>(ent));
-        root.AddChild(std::move(sphereNode));
+        scene.add(ent);
     }
     
     // auto light1 = createLightSource(ecs, glm::vec3(1,5,-6), glm::vec3(1));
@@ -812,16 +812,16 @@ void pbrScene(SpatialNode &root, ecsManager &ecs){
     ecs.AddComponent(animationEntity, animationDraw);
     ecs.AddComponent(animationEntity, animationMaterial);
 
-    root.AddChild(std::make_unique<SpatialNode>(&ecs.GetComponent<Transform>(animationEntity)));
+    scene.add(animationEntity);
 }
 
 
 
-void physicScene(SpatialNode &root, ecsManager &ecs){
+void physicScene(SceneGraph &scene, ecsManager &ecs){
     auto rootEntity = ecs.CreateEntity();
     Transform rootTransform;
     ecs.AddComponent(rootEntity, rootTransform);
-    root.transform = &ecs.GetComponent<Transform>(rootEntity);
+    scene.setRoot(rootEntity);
 
     auto cameraEntity = ecs.CreateEntity();
     ecs.SetEntityName(cameraEntity, "Camera player default");
@@ -831,7 +831,7 @@ void physicScene(SpatialNode &root, ecsManager &ecs){
     cameraComponent.needActivation = true;
     ecs.AddComponent(cameraEntity, cameraTransform);
     ecs.AddComponent(cameraEntity, cameraComponent);
-    root.AddChild(std::make_unique<SpatialNode>(&ecs.GetComponent<Transform>(cameraEntity)));
+    scene.add(cameraEntity);
 
     auto crateEntity = generateCrate(ecs, {0,20, 0});
     ecs.SetEntityName(crateEntity, "crate1");
@@ -845,8 +845,8 @@ void physicScene(SpatialNode &root, ecsManager &ecs){
     ecs.GetComponent<CollisionShape>(crateEntity2).oobb.halfExtents = glm::vec3(1,1,1);
     
 
-    root.AddChild(std::make_unique<SpatialNode>(&ecs.GetComponent<Transform>(crateEntity)));
-    root.AddChild(std::make_unique<SpatialNode>(&ecs.GetComponent<Transform>(crateEntity2)));
+    scene.add(crateEntity);
+    scene.add(crateEntity2);
 
 
     Entity groundE = ecs.CreateEntity();
@@ -866,34 +866,34 @@ void physicScene(SpatialNode &root, ecsManager &ecs){
     ecs.AddComponent(groundE, groundShape);
     ecs.AddComponent(groundE, groundDraw);
     ecs.AddComponent(groundE, groundMat);
-    root.AddChild(std::make_unique<SpatialNode>(&ecs.GetComponent<Transform>(groundE)));
+    scene.add(groundE);
 
     Entity eggSpawner = ecs.CreateEntity();
     CustomBehavior eggSpawnerBehavior;
-    eggSpawnerBehavior.update = [&ecs, &root](float delta){
+    eggSpawnerBehavior.update = [&ecs, &scene](float delta){
         auto actions = InputManager::getInstance().getActions();
         if(actions[InputManager::ActionEnum::ACTION_JUMP ].clicked){
-            auto egg = generateEgg(ecs, &root, {2, 10, 0});
+            auto egg = generateEgg(ecs, scene, {2, 10, 0});
         }
     };
     ecs.AddComponent(eggSpawner, eggSpawnerBehavior);
 
 
-    Entity wall2 = generateWall(ecs, &root);
+    Entity wall2 = generateWall(ecs, scene);
     ecs.GetComponent<Transform>(wall2).rotate({-30,0,0});
     ecs.GetComponent<Transform>(wall2).translate({0,5,5});
-    Entity wall3 = generateWall(ecs, &root);
+    Entity wall3 = generateWall(ecs, scene);
     ecs.GetComponent<Transform>(wall3).rotate({0,0,30});
     ecs.GetComponent<Transform>(wall3).translate({5,5,0});
-    Entity wall4 = generateWall(ecs, &root);
+    Entity wall4 = generateWall(ecs, scene);
     ecs.GetComponent<Transform>(wall4).rotate({0,0,-30});
     ecs.GetComponent<Transform>(wall4).translate({-5,5,0});
-    Entity wall5 = generateWall(ecs, &root);
+    Entity wall5 = generateWall(ecs, scene);
     ecs.GetComponent<Transform>(wall5).rotate({30,0,0});
     ecs.GetComponent<Transform>(wall5).translate({0,5,-5});
 
 
-    // auto plane = generateWall(ecs, &root);
+    // auto plane = generateWall(ecs, scene);
     // CollisionShape &planeShape = ecs.GetComponent<CollisionShape>(plane);
     // planeShape.shapeType = PLANE;
     // planeShape.plane.normal = glm::vec3(0,1,0);
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cmath>
+
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// Minimal float lane type for the batched kernels.
+// Width follows the instruction set the engine is compiled with: 8 lanes with AVX,
+// 4 with SSE2, 1 (plain float) otherwise, so the kernels are written once.
+namespace simd {
+
+#if defined(__AVX__)
+
+constexpr int WIDTH = 8;
+
+struct Float {
+    __m256 v;
+    Float() = default;
+    Float(__m256 value) : v(value) {}
+    Float(float value) : v(_mm256_set1_ps(value)) {}
+};
+
+inline Float load(const float *p) { return _mm256_loadu_ps(p); }
+inline void store(float *p, Float a) { _mm256_storeu_ps(p, a.v); }
+
+inline Float operator+(Float a, Float b) { return _mm256_add_ps(a.v, b.v); }
+inline Float operator-(Float a, Float b) { return _mm256_sub_ps(a.v, b.v); }
+inline Float operator*(Float a, Float b) { return _mm256_mul_ps(a.v, b.v); }
+inline Float operator/(Float a, Float b) { return _mm256_div_ps(a.v, b.v); }
+inline Float operator-(Float a) { return _mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f)); }
+inline Float min(Float a, Float b) { return _mm256_min_ps(a.v, b.v); }
+inline Float max(Float a, Float b) { return _mm256_max_ps(a.v, b.v); }
+inline Float abs(Float a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v); }
+inline Float sqrt(Float a) { return _mm256_sqrt_ps(a.v); }
+
+// masks are Floats with all bits set in the true lanes
+inline Float operator<(Float a, Float b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ); }
+inline Float operator>(Float a, Float b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ); }
+inline Float operator&(Float a, Float b) { return _mm256_and_ps(a.v, b.v); }
+inline Float operator|(Float a, Float b) { return _mm256_or_ps(a.v, b.v); }
+inline Float andNot(Float mask, Float a) { return _mm256_andnot_ps(mask.v, a.v); }
+inline Float select(Float mask, Float a, Float b) { return _mm256_blendv_ps(b.v, a.v, mask.v); }
+inline int bits(Float mask) { return _mm256_movemask_ps(mask.v); }
+
+#elif defined(__SSE2__)
+
+constexpr int WIDTH = 4;
+
+struct Float {
+    __m128 v;
+    Float() = default;
+    Float(__m128 value) : v(value) {}
+    Float(float value) : v(_mm_set1_ps(value)) {}
+};
+
+inline Float load(const float *p) { return _mm_loadu_ps(p); }
+inline void store(float *p, Float a) { _mm_storeu_ps(p, a.v); }
+
+inline Float operator+(Float a, Float b) { return _mm_add_ps(a.v, b.v); }
+inline Float operator-(Float a, Float b) { return _mm_sub_ps(a.v, b.v); }
+inline Float operator*(Float a, Float b) { return _mm_mul_ps(a.v, b.v); }
+inline Float operator/(Float a, Float b) { return _mm_div_ps(a.v, b.v); }
+inline Float operator-(Float a) { return _mm_xor_ps(a.v, _mm_set1_ps(-0.0f)); }
+inline Float min(Float a, Float b) { return _mm_min_ps(a.v, b.v); }
+inline Float max(Float a, Float b) { return _mm_max_ps(a.v, b.v); }
+inline Float abs(Float a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v); }
+inline Float sqrt(Float a) { return _mm_sqrt_ps(a.v); }
+
+inline Float operator<(Float a, Float b) { return _mm_cmplt_ps(a.v, b.v); }
+inline Float operator>(Float a, Float b) { return _mm_cmpgt_ps(a.v, b.v); }
+inline Float operator&(Float a, Float b) { return _mm_and_ps(a.v, b.v); }
+inline Float operator|(Float a, Float b) { return _mm_or_ps(a.v, b.v); }
+inline Float andNot(Float mask, Float a) { return _mm_andnot_ps(mask.v, a.v); }
+inline Float select(Float mask, Float a, Float b) { return _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)); }
+inline int bits(Float mask) { return _mm_movemask_ps(mask.v); }
+
+#else
+
+constexpr int WIDTH = 1;
+
+struct Float {
+    float v;
+    Float() = default;
+    Float(float value) : v(value) {}
+};
+
+inline Float load(const float *p) { return *p; }
+inline void store(float *p, Float a) { *p = a.v; }
+
+inline Float operator+(Float a, Float b) { return a.v + b.v; }
+inline Float operator-(Float a, Float b) { return a.v - b.v; }
+inline Float operator*(Float a, Float b) { return a.v * b.v; }
+inline Float operator/(Float a, Float b) { return a.v / b.v; }
+inline Float operator-(Float a) { return -a.v; }
+inline Float min(Float a, Float b) { return b.v < a.v ? b.v : a.v; }
+inline Float max(Float a, Float b) { return a.v < b.v ? b.v : a.v; }
+inline Float abs(Float a) { return std::fabs(a.v); }
+inline Float sqrt(Float a) { return std::sqrt(a.v); }
+
+// the scalar mask is 1 or 0 stored as a float
+inline Float operator<(Float a, Float b) { return a.v < b.v ? 1.f : 0.f; }
+inline Float operator>(Float a, Float b) { return a.v > b.v ? 1.f : 0.f; }
+inline Float operator&(Float a, Float b) { return (a.v != 0.f && b.v != 0.f) ? 1.f : 0.f; }
+inline Float operator|(Float a, Float b) { return (a.v != 0.f || b.v != 0.f) ? 1.f : 0.f; }
+inline Float andNot(Float mask, Float a) { return mask.v != 0.f ? 0.f : a.v; }
+inline Float select(Float mask, Float a, Float b) { return mask.v != 0.f ? a.v : b.v; }
+inline int bits(Float mask) { return mask.v != 0.f ? 1 : 0; }
+
+#endif
+
+constexpr int ALL_LANES = (1 << WIDTH) - 1;
+
+}
@@ -5,6 +5,7 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include <vector>
+#include <unordered_set>
 #include <memory>
 #include <bits/algorithmfwd.h>
 #include <iostream>
@@ -15,39 +16,78 @@
 using namespace std;
 
 
-class SpatialNode {
-protected:
-    SpatialNode* parent_ = nullptr;
-    std::vector<std::unique_ptr<SpatialNode>> children_;  // Changement ici pour unique_ptr
-
+// Transform hierarchy flattened by depth: level d holds the nodes at depth d with the slot of their parent in
+// level d - 1, so the model matrices are propagated by one linear pass per level. Nodes are entities, the scene
+// root is an implicit node (ROOT) that can follow an entity's transform (setRoot).
+class SceneGraph {
 public:
-    // SceneNode part
-    SpatialNode() = default;
-    SpatialNode(const SpatialNode&) = delete;  // Interdit la copie
-    SpatialNode(SpatialNode&&) = default;  // Autorise le déplacement
-    SpatialNode(Transform* transform): transform(transform){};
-    
-    virtual ~SpatialNode() = default;
-
-    void SetParent(SpatialNode* parent) {
-        this->parent_ = parent;
-    }
-
-    SpatialNode* GetParent() const {
-        return this->parent_;
-    }
-
-    void AddChild(std::unique_ptr<SpatialNode> child);  // Prend un unique_ptr
-    void RemoveChild(SpatialNode* component);
-    
-    bool IsLeaf() const {
-        return children_.empty();
-    }
-
-    void destroy();
-
-    // SpatialNodePart
-    Transform* transform;
-    void updateSelfAndChildTransform();
-    void forceUpdateSelfAndChild();
+    static constexpr Entity ROOT = MAX_ENTITIES;
+
+    // levels are split in chunks of at least this many nodes for the job system
+    size_t minNodesPerChunk = 512;
+
+    SceneGraph();
+    SceneGraph(const SceneGraph&) = delete;
+    SceneGraph& operator=(const SceneGraph&) = delete;
+
+    // the whole scene follows this entity's transform, it then stands for ROOT
+    void setRoot(Entity entity);
+    // the entity's transform follows its parent's one, the parent must already be in the graph
+    void add(Entity entity, Entity parent = ROOT);
+    // the entity and its subtree, before destroying them
+    void remove(Entity entity);
+    // moves the subtree under parent, O(subtree size)
+    void setParent(Entity entity, Entity parent);
+    // only the root is left
+    void clear();
+
+    bool contains(Entity entity) const;
+    Entity getParent(Entity entity) const;
+    size_t size() const { return nodeCount; }
+    size_t getDepth() const { return levels.size(); }
+
+    // recomputes the dirty transforms and everything below them
+    void updateTransforms();
+    void forceUpdateTransforms();
+    // transforms of the nodes in roots and of all their children
+    void collectSubtrees(const std::unordered_set<const Transform*> &roots, std::vector<Transform*> &out);
+
+private:
+    struct Level {
+        std::vector<Entity> entities;
+        std::vector<uint32_t> parents; // slot in the previous level
+        std::vector<Transform*> transforms;
+        std::vector<char> moved; // inserted or re-parented since the last update
+        std::vector<char> marks; // updated / collected by the current pass
+    };
+    struct Slot {
+        uint32_t level = NO_SLOT;
+        uint32_t index = NO_SLOT;
+    };
+    static constexpr uint32_t NO_SLOT = UINT32_MAX;
+    static constexpr Entity NO_ENTITY = UINT32_MAX;
+
+    std::vector<Level> levels;
+    size_t nodeCount = 0;
+
+    // indexed by entity, ROOT included: where the node is stored and its links, for the O(subtree) moves
+    std::vector<Slot> slots;
+    std::vector<Entity> parentOf, firstChild, nextSibling, previousSibling;
+
+    Transform defaultRoot;
+    Entity rootEntity = NO_ENTITY;
+    // the cached transform pointers follow the ecs Transform array
+    size_t transformMoves = 0;
+
+    Entity resolve(Entity entity) const;
+    void link(Entity entity, Entity parent);
+    void unlink(Entity entity);
+    void insertNode(Entity entity, uint32_t level, Transform *transform);
+    void eraseNode(Entity entity);
+    // entity first, parents before their children
+    void collectSubtree(Entity entity, std::vector<Entity> &out) const;
+    void refreshTransforms();
+    void propagate(bool force);
+    void propagateLevel(size_t depth, size_t begin, size_t end, bool force);
+    static void composeBatch(Transform *const *transforms, const Transform *const *parents, int count);
 };
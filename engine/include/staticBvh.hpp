@@ -0,0 +1,111 @@
+#pragma once
+
+#include <engine/include/geometryHelper.hpp>
+#include <engine/include/simd.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// Immutable bounding volume hierarchy for colliders that never move (walls, ground, level boxes).
+// Built once with binned SAH, nodes are 32 bytes and the leaves' boxes are stored as structure
+// of arrays so a whole leaf is tested against a query box in one simd pass.
+class StaticBvh {
+public:
+    void build(const std::vector<Bounds> &bounds, const std::vector<uint32_t> &userData);
+    void clear();
+
+    bool empty() const { return nodes.empty(); }
+    size_t size() const { return leafData.size(); }
+    size_t getNodeCount() const { return nodes.size(); }
+
+    // same callbacks as AabbTree::query and AabbTree::raycast
+    template<typename Callback>
+    void query(const Bounds &bounds, Callback callback) const;
+
+    template<typename Callback>
+    void raycast(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance, Callback callback) const;
+
+private:
+    struct Node {
+        glm::vec3 min;
+        uint32_t first; // first child (second one follows) or first leaf box
+        glm::vec3 max;
+        uint32_t count; // 0 for inner nodes
+
+        bool isLeaf() const { return count != 0; }
+    };
+    static_assert(sizeof(Node) == 32, "StaticBvh::Node should stay 32 bytes");
+
+    static constexpr int MAX_LEAF_SIZE = simd::WIDTH > 4 ? simd::WIDTH : 4;
+    static constexpr int BIN_COUNT = 12;
+    static constexpr int STACK_SIZE = 64;
+
+    std::vector<Node> nodes;
+    // leaf boxes in leaf order, padded to a whole simd load
+    std::vector<float> minX, minY, minZ, maxX, maxY, maxZ;
+    std::vector<uint32_t> leafData;
+
+    // returns the mask of the boxes [first, first+count) overlapping bounds
+    int overlapMask(uint32_t first, int count, const Bounds &bounds) const;
+};
+
+template<typename Callback>
+void StaticBvh::query(const Bounds &bounds, Callback callback) const {
+    if (nodes.empty()) return;
+
+    uint32_t stack[STACK_SIZE];
+    int count = 0;
+    stack[count++] = 0;
+
+    while (count > 0) {
+        const Node &node = nodes[stack[--count]];
+        if (node.min.x > bounds.max.x || node.max.x < bounds.min.x ||
+            node.min.y > bounds.max.y || node.max.y < bounds.min.y ||
+            node.min.z > bounds.max.z || node.max.z < bounds.min.z) continue;
+
+        if (node.isLeaf()) {
+            for (uint32_t i = 0; i < node.count; i += simd::WIDTH) {
+                int lanes = node.count - i < (uint32_t) simd::WIDTH ? node.count - i : simd::WIDTH;
+                int mask = overlapMask(node.first + i, lanes, bounds);
+                for (int lane = 0; mask; lane++, mask >>= 1) {
+                    if ((mask & 1) && !callback(leafData[node.first + i + lane])) return;
+                }
+            }
+        } else {
+            stack[count++] = node.first + 1;
+            stack[count++] = node.first;
+        }
+    }
+}
+
+template<typename Callback>
+void StaticBvh::raycast(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance, Callback callback) const {
+    if (nodes.empty()) return;
+
+    glm::vec3 invDirection = 1.f / direction;
+
+    uint32_t stack[STACK_SIZE];
+    int count = 0;
+    stack[count++] = 0;
+
+    while (count > 0) {
+        const Node &node = nodes[stack[--count]];
+
+        float tMin = 0.f, tMax = maxDistance;
+        if (!Bounds(node.min, node.max).intersectRay(origin, invDirection, tMin, tMax)) continue;
+
+        if (node.isLeaf()) {
+            for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                Bounds leaf({minX[i], minY[i], minZ[i]}, {maxX[i], maxY[i], maxZ[i]});
+                tMin = 0.f, tMax = maxDistance;
+                if (!leaf.intersectRay(origin, invDirection, tMin, tMax)) continue;
+
+                maxDistance = callback(leafData[i], maxDistance);
+                if (maxDistance < 0.f) return;
+            }
+        } else {
+            stack[count++] = node.first + 1;
+            stack[count++] = node.first;
+        }
+    }
+}
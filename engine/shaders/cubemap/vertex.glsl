@@ -3,8 +3,14 @@
 layout(location = 0) in vec3 vertices_position_modelspace;
 layout(location = 1) in vec2 texCoord;
 
-uniform mat4 p;
-uniform mat4 v;
+// per view, CameraUniforms
+layout(std140) uniform CameraBlock {
+    mat4 v;
+    mat4 p;
+    vec4 cameraPosition;
+    float time;
+};
+
 uniform mat4 model;
 
 out vec3 TexCoords;
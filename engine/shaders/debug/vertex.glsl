@@ -6,8 +6,14 @@ layout(location = 0) in vec3 vertices_position_modelspace;
 
 uniform vec3 scale = vec3(1);
 
-uniform mat4 v;
-uniform mat4 p;
+// per view, CameraUniforms
+layout(std140) uniform CameraBlock {
+    mat4 v;
+    mat4 p;
+    vec4 cameraPosition;
+    float time;
+};
+
 uniform mat4 model;
 
 
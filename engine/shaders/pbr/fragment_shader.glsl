@@ -34,7 +34,13 @@ uniform vec3 lightColors[MAX_LIGHT];// = vec3[MAX_LIGHT](vec3(1.f));
 uniform float indensiteScaleLight = 10.f;
 
 
-in vec3 camPos;
+// per view, CameraUniforms
+layout(std140) uniform CameraBlock {
+    mat4 v;
+    mat4 p;
+    vec4 cameraPosition;
+    float time;
+};
 
 uniform bool hasTexture = false;
 
@@ -104,7 +110,7 @@ void main(){
 
 
     vec3 N = normalize(normal);
-    vec3 V = normalize(camPos - WorldPos);
+    vec3 V = normalize(cameraPosition.xyz - WorldPos);
     vec3 R = reflect(-V, N); 
 
     vec3 F0 = vec3(0.04); 
@@ -7,17 +7,35 @@ layout(location = 2) in vec3 vNormal;
 
 layout(location = 3) in vec4 weights;
 layout(location = 4) in ivec4 indices;
+// model matrix of the instance, replaces the model uniform when instanced is set
+layout(location = 5) in mat4 instanceModel;
+
+// per view, CameraUniforms
+layout(std140) uniform CameraBlock {
+    mat4 v;
+    mat4 p;
+    vec4 cameraPosition;
+    float time;
+};
 
-uniform mat4 p;
-uniform mat4 v;
 uniform mat4 model;
+uniform bool instanced;
 
-uniform mat4 bones[128];
+// bone matrices of every skinned drawable of the frame, 4 texels per matrix, the drawn ones start at boneOffset
+uniform samplerBuffer bonePalette;
+uniform int boneOffset;
 
 out vec2 texCoords;
 out vec3 WorldPos;
 out vec3 normalVal;
-out vec3 camPos;
+
+mat4 getBone(int index) {
+    int texel = 4 * (boneOffset + index);
+    return mat4(texelFetch(bonePalette, texel),
+                texelFetch(bonePalette, texel + 1),
+                texelFetch(bonePalette, texel + 2),
+                texelFetch(bonePalette, texel + 3));
+}
 
 void skinning(inout vec3 p, inout vec3 n, vec4 weights, ivec4 indices) {
     float sumWeights = weights.x + weights.y + weights.z + weights.w;
@@ -28,10 +46,10 @@ void skinning(inout vec3 p, inout vec3 n, vec4 weights, ivec4 indices) {
 
         // 2. Combinaison linéaire des matrices de bone
         mat4 m = 
-            bones[indices.x] * weights.x +
-            bones[indices.y] * weights.y +
-            bones[indices.z] * weights.z +
-            bones[indices.w] * weights.w;
+            getBone(indices.x) * weights.x +
+            getBone(indices.y) * weights.y +
+            getBone(indices.z) * weights.z +
+            getBone(indices.w) * weights.w;
 
         // 3. Appliquer au vertex et à la normale
         p = (m * vec4(p, 1.0)).xyz;
@@ -47,12 +65,12 @@ void main(){
 
     skinning(pos, normal, weights, indices);
 
-    gl_Position = vec4(pos,1);
-    gl_Position = p * v * model *  gl_Position;
+    mat4 modelMatrix = instanced ? instanceModel : model;
 
-    camPos = vec3(inverse(v)[3]);
+    gl_Position = vec4(pos,1);
+    gl_Position = p * v * modelMatrix *  gl_Position;
 
-    normalVal = normalize(mat3(transpose(inverse(model))) * vNormal);
-    WorldPos = vec3(model * vec4(vertices_position_modelspace, 1.0));
+    normalVal = normalize(mat3(transpose(inverse(modelMatrix))) * vNormal);
+    WorldPos = vec3(modelMatrix * vec4(vertices_position_modelspace, 1.0));
 }
 
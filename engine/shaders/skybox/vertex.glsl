@@ -3,8 +3,14 @@ layout (location = 0) in vec3 aPos;
 
 out vec3 TexCoords;
 
-uniform mat4 p;
-uniform mat4 v;
+// per view, CameraUniforms
+layout(std140) uniform CameraBlock {
+    mat4 v;
+    mat4 p;
+    vec4 cameraPosition;
+    float time;
+};
+
 uniform mat4 model;
 
 void main()
@@ -0,0 +1,181 @@
+#include <engine/include/aabbTree.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+
+int AabbTree::allocateNode() {
+    if (freeList == NULL_NODE) {
+        nodes.emplace_back();
+        return (int) nodes.size() - 1;
+    }
+
+    int node = freeList;
+    freeList = nodes[node].parent;
+    nodes[node] = Node();
+    return node;
+}
+
+void AabbTree::freeNode(int node) {
+    nodes[node].parent = freeList;
+    nodes[node].height = -1;
+    freeList = node;
+}
+
+int AabbTree::createProxy(const Bounds &bounds, uint32_t userData) {
+    int proxy = allocateNode();
+    nodes[proxy].bounds = bounds.expanded(margin);
+    nodes[proxy].userData = userData;
+    nodes[proxy].height = 0;
+    insertLeaf(proxy);
+    proxyCount++;
+    return proxy;
+}
+
+void AabbTree::destroyProxy(int proxy) {
+    assert(nodes[proxy].isLeaf() && "Destroying a node that isn't a proxy.");
+    removeLeaf(proxy);
+    freeNode(proxy);
+    proxyCount--;
+}
+
+bool AabbTree::moveProxy(int proxy, const Bounds &bounds) {
+    if (nodes[proxy].bounds.contains(bounds)) return false;
+
+    removeLeaf(proxy);
+    nodes[proxy].bounds = bounds.expanded(margin);
+    insertLeaf(proxy);
+    return true;
+}
+
+void AabbTree::insertLeaf(int leaf) {
+    if (root == NULL_NODE) {
+        root = leaf;
+        nodes[root].parent = NULL_NODE;
+        return;
+    }
+
+    // walk down to the sibling with the cheapest surface area increase
+    const Bounds leafBounds = nodes[leaf].bounds;
+    int index = root;
+    while (!nodes[index].isLeaf()) {
+        const Node &node = nodes[index];
+        float area = node.bounds.surfaceArea();
+        float combinedArea = node.bounds.merged(leafBounds).surfaceArea();
+
+        // cost of a new parent here, and the increase pushed down to the children
+        float cost = 2.f * combinedArea;
+        float inheritanceCost = 2.f * (combinedArea - area);
+
+        auto childCost = [&](int child) {
+            const Bounds merged = nodes[child].bounds.merged(leafBounds);
+            if (nodes[child].isLeaf()) return merged.surfaceArea() + inheritanceCost;
+            return merged.surfaceArea() - nodes[child].bounds.surfaceArea() + inheritanceCost;
+        };
+        float cost1 = childCost(node.child1);
+        float cost2 = childCost(node.child2);
+
+        if (cost < cost1 && cost < cost2) break;
+        index = cost1 < cost2 ? node.child1 : node.child2;
+    }
+
+    int sibling = index;
+    int oldParent = nodes[sibling].parent;
+    int newParent = allocateNode();
+    nodes[newParent].parent = oldParent;
+    nodes[newParent].bounds = leafBounds.merged(nodes[sibling].bounds);
+    nodes[newParent].height = nodes[sibling].height + 1;
+    nodes[newParent].child1 = sibling;
+    nodes[newParent].child2 = leaf;
+    nodes[sibling].parent = newParent;
+    nodes[leaf].parent = newParent;
+
+    if (oldParent != NULL_NODE) {
+        if (nodes[oldParent].child1 == sibling) nodes[oldParent].child1 = newParent;
+        else nodes[oldParent].child2 = newParent;
+    } else {
+        root = newParent;
+    }
+
+    refit(nodes[leaf].parent);
+}
+
+void AabbTree::removeLeaf(int leaf) {
+    if (leaf == root) {
+        root = NULL_NODE;
+        return;
+    }
+
+    int parent = nodes[leaf].parent;
+    int grandParent = nodes[parent].parent;
+    int sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+
+    if (grandParent != NULL_NODE) {
+        if (nodes[grandParent].child1 == parent) nodes[grandParent].child1 = sibling;
+        else nodes[grandParent].child2 = sibling;
+        nodes[sibling].parent = grandParent;
+        freeNode(parent);
+        refit(grandParent);
+    } else {
+        root = sibling;
+        nodes[sibling].parent = NULL_NODE;
+        freeNode(parent);
+    }
+}
+
+// fix heights and boxes up to the root, rebalancing on the way
+void AabbTree::refit(int index) {
+    while (index != NULL_NODE) {
+        index = balance(index);
+
+        Node &node = nodes[index];
+        node.height = 1 + std::max(nodes[node.child1].height, nodes[node.child2].height);
+        node.bounds = nodes[node.child1].bounds.merged(nodes[node.child2].bounds);
+
+        index = node.parent;
+    }
+}
+
+// rotates the taller child up if the subtree is unbalanced, returns the new subtree root
+int AabbTree::balance(int a) {
+    Node &A = nodes[a];
+    if (A.isLeaf() || A.height < 2) return a;
+
+    int b = A.child1;
+    int c = A.child2;
+    int diff = nodes[c].height - nodes[b].height;
+    if (std::abs(diff) <= 1) return a;
+
+    // `up` takes the place of a, `down` is the other child of a
+    int up = diff > 0 ? c : b;
+    int down = diff > 0 ? b : c;
+    Node &U = nodes[up];
+    int f = U.child1;
+    int g = U.child2;
+
+    U.child1 = a;
+    U.parent = A.parent;
+    A.parent = up;
+
+    if (U.parent != NULL_NODE) {
+        if (nodes[U.parent].child1 == a) nodes[U.parent].child1 = up;
+        else nodes[U.parent].child2 = up;
+    } else {
+        root = up;
+    }
+
+    // the taller grandchild stays under up, the other goes under a
+    int keep = nodes[f].height > nodes[g].height ? f : g;
+    int give = keep == f ? g : f;
+    U.child2 = keep;
+    A.child1 = down;
+    A.child2 = give;
+    nodes[give].parent = a;
+
+    A.bounds = nodes[down].bounds.merged(nodes[give].bounds);
+    A.height = 1 + std::max(nodes[down].height, nodes[give].height);
+    U.bounds = A.bounds.merged(nodes[keep].bounds);
+    U.height = 1 + std::max(A.height, nodes[keep].height);
+
+    return up;
+}
@@ -1,28 +1,65 @@
 #include <engine/include/ecs/implementations/components.hpp>
 #include <iostream>
+#include <cfloat>
+#include <cassert>
 #include <glm/gtx/norm.hpp>
 
 
 void Drawable::draw(float renderDistance){
-    if (switchDistance > 0 && renderDistance > switchDistance) {
-        lodLower->draw(renderDistance);
-        return;
-    }
+    Drawable &lod = lodAt(renderDistance);
+    glBindVertexArray(lod.VAO);
+    lod.drawElements();
+    glBindVertexArray(0);
+}
 
+Drawable& Drawable::lodAt(float renderDistance){
+    if (switchDistance > 0 && renderDistance > switchDistance) return lodLower->lodAt(renderDistance);
+    return *this;
+}
 
-    glBindVertexArray(VAO);
-    
+void Drawable::drawElements(){
     glDrawElements(
                 GL_TRIANGLES,      // mode
                 indexCount,
                 GL_UNSIGNED_SHORT,   // type
                 (void*)0           // element array buffer offset
                 );
+}
 
-    glBindVertexArray(0);
+void Drawable::computeBounds(const std::vector<Vertex> &vertices){
+    if(vertices.empty()){
+        localBounds = Bounds();
+        localSphere = BoundingSphere();
+        return;
+    }
+    glm::vec3 min(FLT_MAX), max(-FLT_MAX);
+    for(auto &vertex: vertices){
+        min = glm::min(min, vertex.position);
+        max = glm::max(max, vertex.position);
+    }
+    localBounds = Bounds(min, max);
+
+    // centered on the box, tighter than its half diagonal for round meshes
+    float radiusSq = 0.f;
+    glm::vec3 center = localBounds.center();
+    for(auto &vertex: vertices) radiusSq = std::max(radiusSq, glm::length2(vertex.position - center));
+    localSphere = BoundingSphere(center, std::sqrt(radiusSq));
+}
+
+// FNV-1a
+static uint64_t hashBytes(const void *data, size_t size, uint64_t hash = 14695981039346656037ull){
+    const unsigned char *bytes = (const unsigned char*) data;
+    for(size_t i = 0; i < size; i++){
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
 }
 
 void Drawable::init(std::vector<Vertex> &vertices, std::vector<short unsigned int> &indices){
+    computeBounds(vertices);
+    meshKey = hashBytes(indices.data(), indices.size() * sizeof(unsigned short), hashBytes(vertices.data(), vertices.size() * sizeof(Vertex)));
+
     glGenVertexArrays(1,&VAO);
     glGenBuffers(1, &VBO);
     glGenBuffers(1, &EBO);
@@ -69,29 +106,32 @@ CustomProgram::CustomProgram(Program *progPtr): Component(){
     programPtr = progPtr;
 }
 
+// T * R * S without the intermediate matrices: the rotation columns scaled by the scale
 glm::mat4 Transform::getLocalModelMatrix(){
-    glm::mat4 R = glm::toMat4(rotationQuat);
-    return glm::translate(glm::mat4(1.0f), pos)
-         * R
-         * glm::scale(glm::mat4(1.0f), scale);
+    glm::mat3 R = glm::mat3_cast(rotationQuat);
+    return glm::mat4(
+        glm::vec4(R[0] * scale.x, 0.f),
+        glm::vec4(R[1] * scale.y, 0.f),
+        glm::vec4(R[2] * scale.z, 0.f),
+        glm::vec4(pos, 1.f));
 }
 
-
-
 void Transform::computeModelMatrix(){
     modelMatrix = getLocalModelMatrix();
     dirty = false;
-
-    if(eulerStorageDirty) eulerRotStorage = getLocalRotation();
-    eulerStorageDirty = false;
+    version++;
 }
 
 void Transform::computeModelMatrix(const glm::mat4& parentGlobalModelMatrix){
     modelMatrix = parentGlobalModelMatrix * getLocalModelMatrix();
     dirty = false;
+    version++;
+}
 
+const glm::vec3& Transform::getEditorRotation(){
     if(eulerStorageDirty) eulerRotStorage = getLocalRotation();
     eulerStorageDirty = false;
+    return eulerRotStorage;
 }
 
 
@@ -141,6 +181,8 @@ void Transform::setLocalRotation(glm::vec3 rotationAngles){
     }
 
     rotationQuat = glm::toQuat(rotationMatrix);
+    eulerRotStorage = rotationAngles;
+    eulerStorageDirty = false;
     dirty = true;
 }
 
@@ -150,6 +192,7 @@ void Transform::setLocalRotation(glm::vec3 rotationAngles){
 // }
 void Transform::setLocalRotation(const glm::quat &q) {
     rotationQuat = glm::normalize(q);
+    eulerStorageDirty = true;
     dirty = true;
 }
 
@@ -165,6 +208,7 @@ void Transform::rotate(glm::vec3 rotations){
     glm::vec3 radians = glm::radians(rotations);
     glm::quat dq = glm::quat(radians);  
     rotationQuat = glm::normalize(dq * rotationQuat);
+    eulerStorageDirty = true;
     dirty = true;
 }
 
@@ -202,13 +246,76 @@ bool CollisionShape::canSee(CollisionShape &checker, CollisionShape &checked){
     return (checker.mask & checked.layer) != 0;
 }
 
-OverlapingShape spherePlaneIntersection(Sphere &sphereA, Transform &transformA, Plane &planeB, Transform &transformB){
+WorldCollider CollisionShape::computeWorld(Transform &transform) const {
+    WorldCollider res;
+    res.position = transform.getGlobalPosition();
+
+    switch (shapeType) {
+        case RAY:
+            res.direction = transform.applyRotation(ray.ray_direction);
+            res.unitDirection = glm::normalize(res.direction);
+            break;
+        case PLANE:
+            res.normal = glm::normalize(transform.applyRotation(plane.normal));
+            break;
+        case OOBB:
+            res.modelMatrix = transform.getModelMatrix();
+            res.invModelMatrix = glm::inverse(res.modelMatrix);
+            res.oobb = oobb.toWorld(res.modelMatrix);
+            break;
+        case TRIANGLE_MESH:
+        case HEIGHTFIELD:
+        case COMPOUND:
+            res.modelMatrix = transform.getModelMatrix();
+            res.invModelMatrix = glm::inverse(res.modelMatrix);
+            break;
+        default:
+            break;
+    }
+    return res;
+}
+
+// same as above from a full matrix (compound children)
+WorldCollider CollisionShape::computeWorld(const glm::mat4 &modelMatrix) const {
+    WorldCollider res;
+    res.position = glm::vec3(modelMatrix[3]);
+
+    switch (shapeType) {
+        case RAY:
+            res.direction = glm::mat3(modelMatrix) * ray.ray_direction;
+            res.unitDirection = glm::normalize(res.direction);
+            break;
+        case PLANE:
+            res.normal = glm::normalize(glm::transpose(glm::inverse(glm::mat3(modelMatrix))) * plane.normal);
+            break;
+        case OOBB:
+            res.modelMatrix = modelMatrix;
+            res.invModelMatrix = glm::inverse(modelMatrix);
+            res.oobb = oobb.toWorld(modelMatrix);
+            break;
+        case TRIANGLE_MESH:
+        case HEIGHTFIELD:
+        case COMPOUND:
+            res.modelMatrix = modelMatrix;
+            res.invModelMatrix = glm::inverse(modelMatrix);
+            break;
+        default:
+            break;
+    }
+    return res;
+}
+
+void CollisionShape::updateWorld(Transform &transform) {
+    world = computeWorld(transform);
+}
+
+OverlapingShape spherePlaneIntersection(const Sphere &sphereA, const WorldCollider &worldA, const Plane &, const WorldCollider &worldB){
     OverlapingShape res;
     
     
-    glm::vec3 globalPlaneNormal = glm::normalize(transformB.applyRotation(planeB.normal));
-    glm::vec3 globalSpherePos = transformA.getGlobalPosition();
-    glm::vec3 globalPlanePos = transformB.getGlobalPosition();
+    glm::vec3 globalPlaneNormal = worldB.normal;
+    glm::vec3 globalSpherePos = worldA.position;
+    glm::vec3 globalPlanePos = worldB.position;
 
     float distanceFromPlane = glm::dot(globalPlaneNormal, globalSpherePos - globalPlanePos);
 
@@ -218,7 +325,7 @@ OverlapingShape spherePlaneIntersection(Sphere &sphereA, Transform &transformA,
         res.exist = true;
         res.correctionDepth = abs(distanceFromPlane - sphereA.radius);
         res.normal = -globalPlaneNormal;
-        res.position = transformA.getGlobalPosition() - sphereA.radius * res.normal;
+        res.position = worldA.position - sphereA.radius * res.normal;
     }
 
     return res;
@@ -252,36 +359,35 @@ float raycast(glm::vec3 rayOrigin, glm::vec3 rayDirection, glm::vec3 spherePosit
 
 
 // TODO: fix
-OverlapingShape raySphereIntersection(Ray &rayA, Transform &transformA, Sphere &sphereB, Transform &transformB){
+OverlapingShape raySphereIntersection(const Ray &, const WorldCollider &worldA, const Sphere &sphereB, const WorldCollider &worldB){
     OverlapingShape res;
 
-    glm::vec3 globalPosSphere = transformB.getGlobalPosition();
-    glm::vec3 globalPosRay = transformA.getGlobalPosition();
+    glm::vec3 globalPosSphere = worldB.position;
+    glm::vec3 globalPosRay = worldA.position;
     
 
-    float length = raycast(globalPosRay, transformA.applyRotation(rayA.ray_direction), globalPosSphere, sphereB.radius);
+    float length = raycast(globalPosRay, worldA.direction, globalPosSphere, sphereB.radius);
 
     if(length < 0) return res;
 
     res.exist = true;
     res.correctionDepth = length;
-    res.normal = glm::normalize(globalPosSphere - (globalPosRay + length * transformA.applyRotation(rayA.ray_direction)));
-    res.position = globalPosRay + length * transformA.applyRotation(rayA.ray_direction);
+    res.normal = glm::normalize(globalPosSphere - (globalPosRay + length * worldA.direction));
+    res.position = globalPosRay + length * worldA.direction;
     return res;
 }
 
-OverlapingShape rayPlaneIntersection(Ray &rayA, Transform &transformA, Plane &planeB, Transform &transformB){
+OverlapingShape rayPlaneIntersection(const Ray &rayA, const WorldCollider &worldA, const Plane &, const WorldCollider &worldB){
     OverlapingShape res;
 
-    glm::vec3 globalPosA = transformA.getGlobalPosition();
-    glm::vec3 globalPosB = transformB.getGlobalPosition();
+    glm::vec3 globalPosA = worldA.position;
+    glm::vec3 globalPosB = worldB.position;
 
     
-    glm::vec3 planeNormal(glm::normalize(transformB.applyRotation(planeB.normal) ));
-    glm::vec3 rayDirection(glm::normalize(transformA.applyRotation(rayA.ray_direction)));
+    glm::vec3 planeNormal(worldB.normal);
+    glm::vec3 rayDirection(worldA.unitDirection);
     
     float nd = glm::dot(rayDirection, planeNormal);
-    float pn = glm::dot(globalPosB, planeNormal);
 
     if(nd >= 0.f) return res;
 
@@ -298,12 +404,12 @@ OverlapingShape rayPlaneIntersection(Ray &rayA, Transform &transformA, Plane &pl
     return res;
 }
 
-OverlapingShape aabbIntersection(Aabb &aabbA, Transform &transformA, Aabb &aabbB, Transform &transformB){
+OverlapingShape aabbIntersection(const Aabb &aabbA, const WorldCollider &worldA, const Aabb &aabbB, const WorldCollider &worldB){
     OverlapingShape res;
 
 
-    glm::vec3 globalPosA = transformA.getGlobalPosition();
-    glm::vec3 globalPosB = transformB.getGlobalPosition();
+    glm::vec3 globalPosA = worldA.position;
+    glm::vec3 globalPosB = worldB.position;
 
     glm::vec3 minA = globalPosA - aabbA.diag ;
     glm::vec3 minB = globalPosB - aabbB.diag ;
@@ -320,17 +426,17 @@ OverlapingShape aabbIntersection(Aabb &aabbA, Transform &transformA, Aabb &aabbB
         res.exist = true;
         res.normal = glm::normalize(globalPosA - globalPosB);
         res.correctionDepth = 0;
-        res.position = transformA.getGlobalPosition() + (globalPosA - globalPosB) / 2.f;
+        res.position = worldA.position + (globalPosA - globalPosB) / 2.f;
     }
 
     return res;
 }
 
-OverlapingShape aabbSphereIntersection(Aabb &aabbA, Transform &transformA, Sphere &sphereB, Transform &transformB){
+OverlapingShape aabbSphereIntersection(const Aabb &aabbA, const WorldCollider &worldA, const Sphere &sphereB, const WorldCollider &worldB){
     OverlapingShape res;
 
-    glm::vec3 globalPosA = transformA.getGlobalPosition();
-    glm::vec3 globalPosB = transformB.getGlobalPosition();
+    glm::vec3 globalPosA = worldA.position;
+    glm::vec3 globalPosB = worldB.position;
 
     glm::vec3 minA = globalPosA - aabbA.diag ;
     glm::vec3 maxA = globalPosA + aabbA.diag ;
@@ -353,107 +459,195 @@ OverlapingShape aabbSphereIntersection(Aabb &aabbA, Transform &transformA, Spher
     return res;
 }
 
-bool testOverlap(float minA, float maxA, float minB, float maxB, float& overlap) {
-    if (maxA < minB || maxB < minA) {
-        return false;
+WorldOobb Oobb::toWorld(const glm::mat4 &modelMatrix) const {
+    WorldOobb res;
+    res.center = glm::vec3(modelMatrix[3]);
+    for (int i = 0; i < 3; i++) {
+        glm::vec3 column = glm::vec3(modelMatrix[i]);
+        float scale = glm::length(column);
+        // le scale du transform est porté par les demi-extensions
+        // un scale nul aplatit la boîte, l'axe unitaire évite les NaN
+        if (scale > 1e-6f) {
+            res.axes[i] = column * (1.f / scale);
+        } else {
+            res.axes[i] = glm::vec3(0.f);
+            res.axes[i][i] = 1.f;
+            scale = 0.f;
+        }
+        res.halfExtents[i] = halfExtents[i] * scale;
     }
-    
-    overlap = std::min(maxA, maxB) - std::max(minA, minB);
-    return true;
+    return res;
 }
 
+void WorldOobbBatch::set(int lane, const WorldOobb &oobb) {
+    for (int k = 0; k < 3; k++) {
+        center[k][lane] = oobb.center[k];
+        halfExtents[k][lane] = oobb.halfExtents[k];
+        for (int i = 0; i < 3; i++) {
+            axes[i][k][lane] = oobb.axes[i][k];
+        }
+    }
+}
 
-void projectObb(const Oobb& oobb, const glm::mat4& modelMatrix, const glm::vec3& axis, float& min, float& max) {
-    glm::vec3 axes[3] = {
-        glm::vec3(modelMatrix[0]),
-        glm::vec3(modelMatrix[1]),
-        glm::vec3(modelMatrix[2])
-    };
-    
-    glm::vec3 center = glm::vec3(modelMatrix[3]);
-    
-    // Calcule le rayon projeté (théorème de Pythagore généralisé)
+void WorldOobbBatch::clear(int firstLane) {
+    WorldOobb unit;
+    unit.center = glm::vec3(0.f);
+    unit.axes[0] = glm::vec3(1.f, 0.f, 0.f);
+    unit.axes[1] = glm::vec3(0.f, 1.f, 0.f);
+    unit.axes[2] = glm::vec3(0.f, 0.f, 1.f);
+    unit.halfExtents = glm::vec3(1.f);
+    for (int lane = firstLane; lane < simd::WIDTH; lane++) set(lane, unit);
+}
+
+static float projectedRadius(const WorldOobb &oobb, const glm::vec3 &axis) {
     float radius = 0.0f;
     for (int i = 0; i < 3; i++) {
-        radius += fabs(glm::dot(axis, axes[i])) * oobb.halfExtents[i];
+        radius += std::fabs(glm::dot(axis, oobb.axes[i])) * oobb.halfExtents[i]; // float overload, same rounding as the simd batch
     }
-    
-    float centerProj = glm::dot(center, axis);
-    
-    min = centerProj - radius;
-    max = centerProj + radius;
+    return radius;
 }
 
-OverlapingShape oobbIntersection(Oobb &oobbA, Transform &transformA, Oobb &oobbB, Transform &transformB) {
+// SAT over the 15 axes, keeps the smallest penetration, stops at the first separating axis
+OverlapingShape oobbIntersection(const WorldOobb &oobbA, const WorldOobb &oobbB) {
     OverlapingShape res;
-    
-    glm::mat4 modelA = transformA.getModelMatrix();
-    glm::mat4 modelB = transformB.getModelMatrix();
-    
-    glm::vec3 axesA[3] = {
-        glm::normalize(glm::vec3(modelA[0])),
-        glm::normalize(glm::vec3(modelA[1])),
-        glm::normalize(glm::vec3(modelA[2]))
-    };
-    
-    glm::vec3 axesB[3] = {
-        glm::normalize(glm::vec3(modelB[0])),
-        glm::normalize(glm::vec3(modelB[1])),
-        glm::normalize(glm::vec3(modelB[2]))
+    res.correctionDepth = FLT_MAX;
+
+    auto overlapOnAxis = [&](const glm::vec3 &axis) {
+        float centerA = glm::dot(oobbA.center, axis);
+        float centerB = glm::dot(oobbB.center, axis);
+        float radiusA = projectedRadius(oobbA, axis);
+        float radiusB = projectedRadius(oobbB, axis);
+        float minA = centerA - radiusA, maxA = centerA + radiusA;
+        float minB = centerB - radiusB, maxB = centerB + radiusB;
+
+        if (maxA < minB || maxB < minA) return false;
+
+        float overlap = std::min(maxA, maxB) - std::max(minA, minB);
+        if (overlap < res.correctionDepth) {
+            res.correctionDepth = overlap;
+            res.normal = axis;
+        }
+        return true;
     };
-    
-    std::vector<glm::vec3> testAxes;
-    
+
     for (int i = 0; i < 3; i++) {
-        testAxes.push_back(axesA[i]);
+        if (!overlapOnAxis(oobbA.axes[i])) return res;
     }
     for (int i = 0; i < 3; i++) {
-        testAxes.push_back(axesB[i]);
+        if (!overlapOnAxis(oobbB.axes[i])) return res;
     }
-    
     for (int i = 0; i < 3; i++) {
         for (int j = 0; j < 3; j++) {
-            glm::vec3 crossAxis = glm::cross(axesA[i], axesB[j]);
-            if (glm::length(crossAxis) > 0.0001f) { // Évite les axes nuls
-                testAxes.push_back(glm::normalize(crossAxis));
-            }
+            glm::vec3 crossAxis = glm::cross(oobbA.axes[i], oobbB.axes[j]);
+            float length = std::sqrt(glm::dot(crossAxis, crossAxis));
+            if (length <= 0.0001f) continue; // axes parallèles
+            if (!overlapOnAxis(crossAxis * (1.f / length))) return res;
         }
     }
-    
-    for (const glm::vec3& axis : testAxes) {
-        if (glm::length(axis) < 0.0001f) continue; // Ignore les axes nuls
-        
-        float minA, maxA, minB, maxB;
-        projectObb(oobbA, modelA, axis, minA, maxA);
-        projectObb(oobbB, modelB, axis, minB, maxB);
-        
-        float overlap;
-        if (!testOverlap(minA, maxA, minB, maxB, overlap)) {
-            return res;
-        }
-        
-        // Garde la plus petite pénétration
-        if (overlap < res.correctionDepth) {
-            res.correctionDepth = overlap;
-            res.normal = axis;
-        }
-    }
-    
+
     res.exist = true;
-    
-    glm::vec3 centerA = glm::vec3(modelA[3]);
-    glm::vec3 centerB = glm::vec3(modelB[3]);
-    glm::vec3 dir = centerB - centerA;
-    
-    if (glm::dot(dir, res.normal) < 0.0f) {
+
+    if (glm::dot(oobbB.center - oobbA.center, res.normal) < 0.0f) {
         res.normal = -res.normal;
     }
+    res.position = oobbA.center + res.normal * res.correctionDepth;
 
-    res.position = transformA.getGlobalPosition() + res.normal * res.correctionDepth;
-    
     return res;
 }
 
+// Same test as above for one box against `count` boxes at once, one box per lane.
+void oobbIntersectionBatch(const WorldOobb &oobbA, const WorldOobbBatch &others, int count, OverlapingShape *results) {
+    using namespace simd;
+
+    const Float trueMask = Float(0.f) < Float(1.f);
+
+    float padding[WIDTH];
+    for (int lane = 0; lane < WIDTH; lane++) padding[lane] = lane < count ? 0.f : 1.f;
+    // unused lanes start separated so the early out only waits for real ones
+    Float separated = Float(0.f) < load(padding);
+
+    Float bestDepth = FLT_MAX;
+    Float normal[3] = {0.f, 0.f, 0.f};
+
+    Float centerB[3], halfB[3], axesB[3][3];
+    for (int k = 0; k < 3; k++) {
+        centerB[k] = load(others.center[k]);
+        halfB[k] = load(others.halfExtents[k]);
+        for (int i = 0; i < 3; i++) axesB[i][k] = load(others.axes[i][k]);
+    }
+
+    auto dot = [](const Float *a, const Float *b) {
+        return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+    };
+
+    Float centerA[3] = {oobbA.center.x, oobbA.center.y, oobbA.center.z};
+    Float axesA[3][3];
+    for (int i = 0; i < 3; i++) {
+        for (int k = 0; k < 3; k++) axesA[i][k] = oobbA.axes[i][k];
+    }
+
+    // returns true once every lane found a separating axis
+    auto testAxis = [&](const Float *axis, Float valid) {
+        Float radiusA = 0.f, radiusB = 0.f;
+        for (int i = 0; i < 3; i++) {
+            radiusA = radiusA + abs(dot(axis, axesA[i])) * Float(oobbA.halfExtents[i]);
+            radiusB = radiusB + abs(dot(axis, axesB[i])) * halfB[i];
+        }
+        Float projA = dot(centerA, axis), projB = dot(centerB, axis);
+        Float minA = projA - radiusA, maxA = projA + radiusA;
+        Float minB = projB - radiusB, maxB = projB + radiusB;
+
+        separated = separated | (((maxA < minB) | (maxB < minA)) & valid);
+
+        Float overlap = min(maxA, maxB) - max(minA, minB);
+        Float better = valid & (overlap < bestDepth);
+        bestDepth = select(better, overlap, bestDepth);
+        for (int k = 0; k < 3; k++) normal[k] = select(better, axis[k], normal[k]);
+
+        return bits(separated) == ALL_LANES;
+    };
+
+    bool allSeparated = false;
+    for (int i = 0; i < 3 && !allSeparated; i++) allSeparated = testAxis(axesA[i], trueMask);
+    for (int i = 0; i < 3 && !allSeparated; i++) allSeparated = testAxis(axesB[i], trueMask);
+    for (int i = 0; i < 3 && !allSeparated; i++) {
+        for (int j = 0; j < 3 && !allSeparated; j++) {
+            const Float *a = axesA[i], *b = axesB[j];
+            Float crossAxis[3] = {
+                a[1] * b[2] - a[2] * b[1],
+                a[2] * b[0] - a[0] * b[2],
+                a[0] * b[1] - a[1] * b[0]
+            };
+            Float length = sqrt(dot(crossAxis, crossAxis));
+            Float valid = length > Float(0.0001f);
+            Float invLength = select(valid, Float(1.f) / length, Float(0.f));
+            for (int k = 0; k < 3; k++) crossAxis[k] = crossAxis[k] * invLength;
+            allSeparated = testAxis(crossAxis, valid);
+        }
+    }
+
+    float depthOut[WIDTH], normalOut[3][WIDTH];
+    int separatedBits = bits(separated);
+    store(depthOut, bestDepth);
+    for (int k = 0; k < 3; k++) store(normalOut[k], normal[k]);
+
+    for (int lane = 0; lane < count; lane++) {
+        OverlapingShape &res = results[lane];
+        res = OverlapingShape();
+        if (separatedBits & (1 << lane)) continue;
+
+        res.exist = true;
+        res.correctionDepth = depthOut[lane];
+        res.normal = glm::vec3(normalOut[0][lane], normalOut[1][lane], normalOut[2][lane]);
+
+        glm::vec3 center(others.center[0][lane], others.center[1][lane], others.center[2][lane]);
+        if (glm::dot(center - oobbA.center, res.normal) < 0.0f) {
+            res.normal = -res.normal;
+        }
+        res.position = oobbA.center + res.normal * res.correctionDepth;
+    }
+}
+
 // OverlapingShape oobbIntersection(Oobb &oobbA, Transform &transformA, Oobb &oobbB, Transform &transformB) {
 //     OverlapingShape res;
 
@@ -502,19 +696,18 @@ OverlapingShape oobbIntersection(Oobb &oobbA, Transform &transformA, Oobb &oobbB
 //     return res;
 // }
 
-OverlapingShape oobbSphereIntersection(Oobb &oobbA, Transform &transformA, Sphere &sphereB, Transform &transformB){
+OverlapingShape oobbSphereIntersection(const Oobb &oobbA, const WorldCollider &worldA, const Sphere &sphereB, const WorldCollider &worldB){
     OverlapingShape res;
 
-    glm::mat4 invTransfoA = glm::inverse(transformA.getModelMatrix());
-    glm::vec4 localSphereCenter = invTransfoA * glm::vec4(transformB.getGlobalPosition(), 1.f);
+    glm::vec4 localSphereCenter = worldA.invModelMatrix * glm::vec4(worldB.position, 1.f);
 
     glm::vec3 closest;
     closest.x = std::max(-oobbA.halfExtents.x, std::min(localSphereCenter.x, oobbA.halfExtents.x));
     closest.y = std::max(-oobbA.halfExtents.y, std::min(localSphereCenter.y, oobbA.halfExtents.y));
     closest.z = std::max(-oobbA.halfExtents.z, std::min(localSphereCenter.z, oobbA.halfExtents.z));
 
-    glm::vec3 closestGlobal = glm::vec3(transformA.getModelMatrix() * glm::vec4(closest, 1.f));
-    glm::vec3 direction = transformB.getGlobalPosition() - closestGlobal;
+    glm::vec3 closestGlobal = glm::vec3(worldA.modelMatrix * glm::vec4(closest, 1.f));
+    glm::vec3 direction = worldB.position - closestGlobal;
     float distance = glm::length(direction);
 
     if (distance > sphereB.radius) return res;
@@ -531,65 +724,736 @@ OverlapingShape oobbSphereIntersection(Oobb &oobbA, Transform &transformA, Spher
     return res;
 }
 
-OverlapingShape CollisionShape::intersectionExist(CollisionShape &shapeA, Transform &transformA, CollisionShape &shapeB, Transform &transformB){
+OverlapingShape sphereIntersection(const Sphere &sphereA, const WorldCollider &worldA, const Sphere &sphereB, const WorldCollider &worldB){
     OverlapingShape res;
 
-    // SPHERE
-    if(shapeA.shapeType == SPHERE && shapeB.shapeType == SPHERE){
-        float radiusSum = shapeA.sphere.radius + shapeB.sphere.radius;
-        float distance = glm::length(transformA.getGlobalPosition() - transformB.getGlobalPosition());
-        
-        float dist = distance - radiusSum;
-        if(dist < 0){
-            res.exist = true;
-            res.correctionDepth = dist;
-            res.normal = glm::normalize(transformA.getGlobalPosition() - transformB.getGlobalPosition());
-            res.position = transformA.getGlobalPosition() - shapeA.sphere.radius * res.normal;
-        }
-        return res;
-    } 
+    float radiusSum = sphereA.radius + sphereB.radius;
+    float distance = glm::length(worldA.position - worldB.position);
     
-    // PLANE
-    else if(shapeA.shapeType == PLANE && shapeB.shapeType == SPHERE){
-        res = spherePlaneIntersection(shapeB.sphere, transformB, shapeA.plane, transformA);
-        res.normal = -res.normal;
-        return res;
-    } else if(shapeA.shapeType == SPHERE && shapeB.shapeType == PLANE){
-        return spherePlaneIntersection(shapeA.sphere, transformA, shapeB.plane, transformB);
-    } 
-    
-    // RAY
-    else if(shapeA.shapeType == RAY && shapeB.shapeType == SPHERE){
-        return raySphereIntersection(shapeA.ray, transformA, shapeB.sphere, transformB);
-    } else if(shapeA.shapeType == SPHERE && shapeB.shapeType == RAY){
-        return raySphereIntersection(shapeB.ray, transformB, shapeA.sphere, transformA);
-    } else if(shapeA.shapeType == RAY && shapeB.shapeType == PLANE){
-        return rayPlaneIntersection(shapeA.ray, transformA, shapeB.plane, transformB);
-    } else if(shapeA.shapeType == PLANE && shapeB.shapeType == RAY){
-        return rayPlaneIntersection(shapeB.ray, transformB, shapeA.plane, transformA);
+    float dist = distance - radiusSum;
+    if(dist < 0){
+        res.exist = true;
+        res.correctionDepth = dist;
+        res.normal = glm::normalize(worldA.position - worldB.position);
+        res.position = worldA.position - sphereA.radius * res.normal;
     }
-    
+    return res;
+}
+
+////////////  Mesh colliders
+
+// calls callback(a, b, c) with the world space triangles of a mesh collider near bounds
+template<typename Callback>
+static void forEachTriangle(const CollisionShape &mesh, const WorldCollider &world, const Bounds &bounds, Callback callback){
+    Bounds localBounds = bounds.transformed(world.invModelMatrix);
+    auto toWorld = [&](const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c){
+        callback(glm::vec3(world.modelMatrix * glm::vec4(a, 1.f)),
+                 glm::vec3(world.modelMatrix * glm::vec4(b, 1.f)),
+                 glm::vec3(world.modelMatrix * glm::vec4(c, 1.f)));
+    };
+    if(mesh.shapeType == TRIANGLE_MESH && mesh.triangleMesh.data) mesh.triangleMesh.data->query(localBounds, toWorld);
+    else if(mesh.shapeType == HEIGHTFIELD && mesh.heightfield.data) mesh.heightfield.data->query(localBounds, toWorld);
+}
+
+static glm::vec3 closestPointOnTriangle(const glm::vec3 &p, const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c){
+    glm::vec3 ab = b - a, ac = c - a, ap = p - a;
+    float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+    if(d1 <= 0.f && d2 <= 0.f) return a;
+
+    glm::vec3 bp = p - b;
+    float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+    if(d3 >= 0.f && d4 <= d3) return b;
+
+    float vc = d1 * d4 - d3 * d2;
+    if(vc <= 0.f && d1 >= 0.f && d3 <= 0.f) return a + ab * (d1 / (d1 - d3));
+
+    glm::vec3 cp = p - c;
+    float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+    if(d6 >= 0.f && d5 <= d6) return c;
+
+    float vb = d5 * d2 - d1 * d6;
+    if(vb <= 0.f && d2 >= 0.f && d6 <= 0.f) return a + ac * (d2 / (d2 - d6));
+
+    float va = d3 * d6 - d5 * d4;
+    if(va <= 0.f && d4 - d3 >= 0.f && d5 - d6 >= 0.f) return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+    float denominator = 1.f / (va + vb + vc);
+    return a + ab * (vb * denominator) + ac * (vc * denominator);
+}
+
+// SAT over the 13 axes, the depth is the smallest move getting the box out
+static OverlapingShape boxTriangleIntersection(const WorldOobb &box, const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c){
+    OverlapingShape res;
+    res.correctionDepth = FLT_MAX;
+
+    const glm::vec3 vertices[3] = {a - box.center, b - box.center, c - box.center};
+    auto overlapOnAxis = [&](glm::vec3 axis){
+        float length = std::sqrt(glm::dot(axis, axis));
+        if(length <= 0.0001f) return true;
+        axis *= 1.f / length;
+
+        float p0 = glm::dot(vertices[0], axis), p1 = glm::dot(vertices[1], axis), p2 = glm::dot(vertices[2], axis);
+        float triangleMin = std::min(p0, std::min(p1, p2));
+        float triangleMax = std::max(p0, std::max(p1, p2));
+        float radius = projectedRadius(box, axis);
+        if(triangleMin > radius || triangleMax < -radius) return false;
+
+        // the box goes back along the normal, which points toward the triangle
+        float pushBack = radius - triangleMin;
+        float pushForward = triangleMax + radius;
+        if(pushBack < res.correctionDepth){
+            res.correctionDepth = pushBack;
+            res.normal = axis;
+        }
+        if(pushForward < res.correctionDepth){
+            res.correctionDepth = pushForward;
+            res.normal = -axis;
+        }
+        return true;
+    };
+
+    const glm::vec3 edges[3] = {b - a, c - b, a - c};
+    if(!overlapOnAxis(glm::cross(edges[0], edges[1]))) return res;
+    for(int i = 0; i < 3; i++){
+        if(!overlapOnAxis(box.axes[i])) return res;
+    }
+    for(int i = 0; i < 3; i++){
+        for(int j = 0; j < 3; j++){
+            if(!overlapOnAxis(glm::cross(box.axes[i], edges[j]))) return res;
+        }
+    }
+
+    res.exist = true;
+    res.position = closestPointOnTriangle(box.center, a, b, c);
+    return res;
+}
+
+// contacts against a mesh keep the deepest triangle, the normal points from the shape to the mesh
+OverlapingShape sphereMeshIntersection(const Sphere &sphereA, const WorldCollider &worldA, const CollisionShape &meshB, const WorldCollider &worldB){
+    OverlapingShape res;
+
+    Bounds bounds = Bounds::fromCenter(worldA.position, glm::vec3(sphereA.radius));
+    forEachTriangle(meshB, worldB, bounds, [&](const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c){
+        glm::vec3 closest = closestPointOnTriangle(worldA.position, a, b, c);
+        glm::vec3 direction = closest - worldA.position;
+        float distance = glm::length(direction);
+        float depth = sphereA.radius - distance;
+        if(depth <= 0.f || (res.exist && depth <= res.correctionDepth)) return;
+
+        res.exist = true;
+        res.correctionDepth = depth;
+        res.normal = distance > 0.0001f ? direction / distance : -glm::normalize(glm::cross(b - a, c - a));
+        res.position = closest;
+    });
+    return res;
+}
+
+OverlapingShape boxMeshIntersection(const WorldOobb &boxA, const CollisionShape &meshB, const WorldCollider &worldB){
+    OverlapingShape res;
+
+    glm::vec3 halfExtents(0);
+    for(int i = 0; i < 3; i++) halfExtents += glm::abs(boxA.axes[i]) * boxA.halfExtents[i];
+    forEachTriangle(meshB, worldB, Bounds::fromCenter(boxA.center, halfExtents), [&](const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c){
+        OverlapingShape contact = boxTriangleIntersection(boxA, a, b, c);
+        if(contact.exist && (!res.exist || contact.correctionDepth > res.correctionDepth)) res = contact;
+    });
+    return res;
+}
+
+// closest hit in world space, normal facing the ray
+static float meshRayIntersection(const CollisionShape &mesh, const WorldCollider &world, const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance, glm::vec3 &normal){
+    // t is unchanged by the transform as long as the direction isn't normalized again
+    glm::vec3 localOrigin = glm::vec3(world.invModelMatrix * glm::vec4(origin, 1.f));
+    glm::vec3 localDirection = glm::vec3(world.invModelMatrix * glm::vec4(direction, 0.f));
+
+    glm::vec3 localNormal;
+    float t = -1;
+    if(mesh.shapeType == TRIANGLE_MESH && mesh.triangleMesh.data) t = mesh.triangleMesh.data->raycast(localOrigin, localDirection, maxDistance, localNormal);
+    else if(mesh.shapeType == HEIGHTFIELD && mesh.heightfield.data) t = mesh.heightfield.data->raycast(localOrigin, localDirection, maxDistance, localNormal);
+    if(t < 0.f) return -1;
+
+    normal = glm::normalize(glm::transpose(glm::mat3(world.invModelMatrix)) * localNormal);
+    if(glm::dot(normal, direction) > 0.f) normal = -normal;
+    return t;
+}
+
+OverlapingShape rayMeshIntersection(const Ray &rayA, const WorldCollider &worldA, const CollisionShape &meshB, const WorldCollider &worldB){
+    OverlapingShape res;
+
+    glm::vec3 normal;
+    float t = meshRayIntersection(meshB, worldB, worldA.position, worldA.unitDirection, rayA.length, normal);
+    if(t < 0.f) return res;
+
+    res.exist = true;
+    res.position = worldA.position + t * worldA.unitDirection;
+    res.normal = -normal;
+    res.correctionDepth = t;
+    return res;
+}
+
+using PairTest = OverlapingShape (*)(const CollisionShape &shapeA, const WorldCollider &worldA, const CollisionShape &shapeB, const WorldCollider &worldB);
+
+static OverlapingShape noIntersection(const CollisionShape &, const WorldCollider &, const CollisionShape &, const WorldCollider &){
+    return OverlapingShape();
+}
+
+static OverlapingShape rayMeshTest(const CollisionShape &a, const WorldCollider &wa, const CollisionShape &b, const WorldCollider &wb){
+    return rayMeshIntersection(a.ray, wa, b, wb);
+}
+
+static OverlapingShape sphereMeshTest(const CollisionShape &a, const WorldCollider &wa, const CollisionShape &b, const WorldCollider &wb){
+    return sphereMeshIntersection(a.sphere, wa, b, wb);
+}
+
+// an aabb is a box with the world axes
+static WorldOobb aabbAsOobb(const Aabb &aabb, const WorldCollider &world){
+    WorldOobb box;
+    box.center = world.position;
+    box.axes[0] = {1, 0, 0};
+    box.axes[1] = {0, 1, 0};
+    box.axes[2] = {0, 0, 1};
+    box.halfExtents = aabb.diag;
+    return box;
+}
+
+// slabs in the box frame, a ray starting inside hits at 0
+static OverlapingShape rayBoxIntersection(const Ray &rayA, const WorldCollider &worldA, const WorldOobb &boxB){
+    OverlapingShape res;
+    glm::vec3 offset = worldA.position - boxB.center;
+    float tEnter = 0.f, tExit = rayA.length;
+    glm::vec3 normal = worldA.unitDirection;
+
+    for (int i = 0; i < 3; i++) {
+        float origin = glm::dot(offset, boxB.axes[i]);
+        float direction = glm::dot(worldA.unitDirection, boxB.axes[i]);
+        if (std::fabs(direction) < 1e-8f) {
+            if (std::fabs(origin) > boxB.halfExtents[i]) return res;
+            continue;
+        }
+        float t0 = (-boxB.halfExtents[i] - origin) / direction;
+        float t1 = (boxB.halfExtents[i] - origin) / direction;
+        if (t0 > t1) std::swap(t0, t1);
+        if (t0 > tEnter) {
+            tEnter = t0;
+            normal = direction > 0.f ? boxB.axes[i] : -boxB.axes[i];
+        }
+        tExit = std::min(tExit, t1);
+        if (tEnter > tExit) return res;
+    }
+
+    res.exist = true;
+    res.position = worldA.position + tEnter * worldA.unitDirection;
+    res.normal = normal;
+    res.correctionDepth = tEnter;
+    return res;
+}
+
+// one sided like the sphere, only a box in front of the plane is pushed back
+static OverlapingShape boxPlaneIntersection(const WorldOobb &boxA, const WorldCollider &worldB){
+    OverlapingShape res;
+    const glm::vec3 &planeNormal = worldB.normal;
+
+    float distanceFromPlane = glm::dot(planeNormal, boxA.center - worldB.position);
+    if (distanceFromPlane < 0.f) return res;
+
+    float radius = projectedRadius(boxA, planeNormal);
+    if (distanceFromPlane >= radius) return res;
+
+    res.exist = true;
+    res.correctionDepth = radius - distanceFromPlane;
+    res.normal = -planeNormal;
+    res.position = boxA.center - planeNormal * distanceFromPlane;
+    return res;
+}
+
+static OverlapingShape rayAabbTest(const CollisionShape &a, const WorldCollider &wa, const CollisionShape &b, const WorldCollider &wb){
+    return rayBoxIntersection(a.ray, wa, aabbAsOobb(b.aabb, wb));
+}
+
+static OverlapingShape rayOobbTest(const CollisionShape &a, const WorldCollider &wa, const CollisionShape &, const WorldCollider &wb){
+    return rayBoxIntersection(a.ray, wa, wb.oobb);
+}
+
+static OverlapingShape aabbPlaneTest(const CollisionShape &a, const WorldCollider &wa, const CollisionShape &, const WorldCollider &wb){
+    return boxPlaneIntersection(aabbAsOobb(a.aabb, wa), wb);
+}
+
+static OverlapingShape oobbPlaneTest(const CollisionShape &, const WorldCollider &wa, const CollisionShape &, const WorldCollider &wb){
+    return boxPlaneIntersection(wa.oobb, wb);
+}
+
+static OverlapingShape oobbAabbTest(const CollisionShape &, const WorldCollider &wa, const CollisionShape &b, const WorldCollider &wb){
+    return oobbIntersection(wa.oobb, aabbAsOobb(b.aabb, wb));
+}
+
+static OverlapingShape aabbMeshTest(const CollisionShape &a, const WorldCollider &wa, const CollisionShape &b, const WorldCollider &wb){
+    return boxMeshIntersection(aabbAsOobb(a.aabb, wa), b, wb);
+}
+
+static OverlapingShape oobbMeshTest(const CollisionShape &, const WorldCollider &wa, const CollisionShape &b, const WorldCollider &wb){
+    return boxMeshIntersection(wa.oobb, b, wb);
+}
+
+// B first: same test with the normal turned back from A to B
+template<PairTest test>
+static OverlapingShape swapped(const CollisionShape &a, const WorldCollider &wa, const CollisionShape &b, const WorldCollider &wb){
+    OverlapingShape res = test(b, wb, a, wa);
+    res.normal = -res.normal;
+    return res;
+}
+
+static OverlapingShape dispatchPair(const CollisionShape &shapeA, const WorldCollider &worldA, const CollisionShape &shapeB, const WorldCollider &worldB);
+static bool shapeBounds(const CollisionShape &shape, const WorldCollider &world, Bounds &bounds);
+
+// children near the other shape against it, keeps the deepest contact
+template<bool compoundFirst>
+static OverlapingShape compoundTest(const CollisionShape &a, const WorldCollider &wa, const CollisionShape &b, const WorldCollider &wb){
+    const CollisionShape &compound = compoundFirst ? a : b;
+    const WorldCollider &compoundWorld = compoundFirst ? wa : wb;
+    const CollisionShape &other = compoundFirst ? b : a;
+    const WorldCollider &otherWorld = compoundFirst ? wb : wa;
+
+    OverlapingShape res;
+    const CompoundShapeData *data = compound.compound.data;
+    if(!data) return res;
+
+    auto testChild = [&](uint32_t index){
+        const CompoundChild &child = data->children[index];
+        if(child.trigger && !(child.shape.mask & other.layer)) return true;
+
+        WorldCollider childWorld = child.shape.computeWorld(compoundWorld.modelMatrix * child.localMatrix);
+        OverlapingShape contact = compoundFirst ? dispatchPair(child.shape, childWorld, other, otherWorld)
+                                                : dispatchPair(other, otherWorld, child.shape, childWorld);
+        bool triggerA = res.triggerA || contact.triggerA, triggerB = res.triggerB || contact.triggerB;
+        if(child.trigger){
+            if(compoundFirst) triggerA = triggerA || contact.exist;
+            else triggerB = triggerB || contact.exist;
+        } else if(contact.exist && (!res.exist || std::fabs(contact.correctionDepth) > std::fabs(res.correctionDepth))) {
+            res = contact;
+        }
+        res.triggerA = triggerA;
+        res.triggerB = triggerB;
+        return true;
+    };
+
+    Bounds otherBounds;
+    if(shapeBounds(other, otherWorld, otherBounds)){
+        data->tree.query(otherBounds.transformed(compoundWorld.invModelMatrix), testChild);
+    } else {
+        for(uint32_t i = 0; i < data->children.size(); i++) testChild(i);
+    }
+    return res;
+}
+
+// [shapeA.shapeType][shapeB.shapeType], swapped entries keep the conventions of the former if/else chain
+static const PairTest pairTests[COLLISION_SHAPE_TYPE_COUNT][COLLISION_SHAPE_TYPE_COUNT] = {
+    // RAY
+    {
+        noIntersection,
+        [](const CollisionShape &a, const WorldCollider &wa, const CollisionShape &b, const WorldCollider &wb){ return raySphereIntersection(a.ray, wa, b.sphere, wb); },
+        [](const CollisionShape &a, const WorldCollider &wa, const CollisionShape &b, const WorldCollider &wb){ return rayPlaneIntersection(a.ray, wa, b.plane, wb); },
+        rayAabbTest,
+        rayOobbTest,
+        rayMeshTest,
+        rayMeshTest,
+        compoundTest<false>
+    },
+    // SPHERE
+    {
+        [](const CollisionShape &a, const WorldCollider &wa, const CollisionShape &b, const WorldCollider &wb){ return raySphereIntersection(b.ray, wb, a.sphere, wa); },
+        [](const CollisionShape &a, const WorldCollider &wa, const CollisionShape &b, const WorldCollider &wb){ return sphereIntersection(a.sphere, wa, b.sphere, wb); },
+        [](const CollisionShape &a, const WorldCollider &wa, const CollisionShape &b, const WorldCollider &wb){ return spherePlaneIntersection(a.sphere, wa, b.plane, wb); },
+        [](const CollisionShape &a, const WorldCollider &wa, const CollisionShape &b, const WorldCollider &wb){ return aabbSphereIntersection(b.aabb, wb, a.sphere, wa); },
+        [](const CollisionShape &a, const WorldCollider &wa, const CollisionShape &b, const WorldCollider &wb){ return oobbSphereIntersection(b.oobb, wb, a.sphere, wa); },
+        sphereMeshTest,
+        sphereMeshTest,
+        compoundTest<false>
+    },
+    // PLANE
+    {
+        [](const CollisionShape &a, const WorldCollider &wa, const CollisionShape &b, const WorldCollider &wb){ return rayPlaneIntersection(b.ray, wb, a.plane, wa); },
+        [](const CollisionShape &a, const WorldCollider &wa, const CollisionShape &b, const WorldCollider &wb){
+            OverlapingShape res = spherePlaneIntersection(b.sphere, wb, a.plane, wa);
+            res.normal = -res.normal;
+            return res;
+        },
+        noIntersection,
+        swapped<aabbPlaneTest>,
+        swapped<oobbPlaneTest>,
+        noIntersection,
+        noIntersection,
+        compoundTest<false>
+    },
     // AABB
-    else if(shapeA.shapeType == AABB && shapeB.shapeType == AABB){
-        return aabbIntersection(shapeA.aabb, transformA, shapeB.aabb, transformB);
-    } else if(shapeA.shapeType == AABB && shapeB.shapeType == SPHERE){
-        return aabbSphereIntersection(shapeA.aabb, transformA, shapeB.sphere, transformB);
-    } else if(shapeA.shapeType == SPHERE && shapeB.shapeType == AABB){
-        return aabbSphereIntersection(shapeB.aabb, transformB, shapeA.sphere, transformA);
-    } 
-    
+    {
+        swapped<rayAabbTest>,
+        [](const CollisionShape &a, const WorldCollider &wa, const CollisionShape &b, const WorldCollider &wb){ return aabbSphereIntersection(a.aabb, wa, b.sphere, wb); },
+        aabbPlaneTest,
+        [](const CollisionShape &a, const WorldCollider &wa, const CollisionShape &b, const WorldCollider &wb){ return aabbIntersection(a.aabb, wa, b.aabb, wb); },
+        swapped<oobbAabbTest>,
+        aabbMeshTest,
+        aabbMeshTest,
+        compoundTest<false>
+    },
     // OOBB
-    else if(shapeA.shapeType == OOBB && shapeB.shapeType == OOBB){
-        return oobbIntersection(shapeA.oobb, transformA, shapeB.oobb, transformB);
-    } else if(shapeA.shapeType == OOBB && shapeB.shapeType == SPHERE){
-        return oobbSphereIntersection(shapeA.oobb, transformA, shapeB.sphere, transformB);
-    } else  if(shapeA.shapeType == SPHERE && shapeB.shapeType == OOBB){
-        return oobbSphereIntersection(shapeB.oobb, transformB, shapeA.sphere, transformA);
+    {
+        swapped<rayOobbTest>,
+        [](const CollisionShape &a, const WorldCollider &wa, const CollisionShape &b, const WorldCollider &wb){ return oobbSphereIntersection(a.oobb, wa, b.sphere, wb); },
+        oobbPlaneTest,
+        oobbAabbTest,
+        [](const CollisionShape &, const WorldCollider &wa, const CollisionShape &, const WorldCollider &wb){ return oobbIntersection(wa.oobb, wb.oobb); },
+        oobbMeshTest,
+        oobbMeshTest,
+        compoundTest<false>
+    },
+    // TRIANGLE_MESH
+    {
+        swapped<rayMeshTest>,
+        swapped<sphereMeshTest>,
+        noIntersection,
+        swapped<aabbMeshTest>,
+        swapped<oobbMeshTest>,
+        noIntersection,
+        noIntersection,
+        compoundTest<false>
+    },
+    // HEIGHTFIELD
+    {
+        swapped<rayMeshTest>,
+        swapped<sphereMeshTest>,
+        noIntersection,
+        swapped<aabbMeshTest>,
+        swapped<oobbMeshTest>,
+        noIntersection,
+        noIntersection,
+        compoundTest<false>
+    },
+    // COMPOUND
+    {
+        compoundTest<true>,
+        compoundTest<true>,
+        compoundTest<true>,
+        compoundTest<true>,
+        compoundTest<true>,
+        compoundTest<true>,
+        compoundTest<true>,
+        compoundTest<true>
+    }
+};
+
+static OverlapingShape dispatchPair(const CollisionShape &shapeA, const WorldCollider &worldA, const CollisionShape &shapeB, const WorldCollider &worldB){
+    return pairTests[shapeA.shapeType][shapeB.shapeType](shapeA, worldA, shapeB, worldB);
+}
+
+OverlapingShape CollisionShape::intersectionExist(const CollisionShape &shapeA, const CollisionShape &shapeB){
+    return pairTests[shapeA.shapeType][shapeB.shapeType](shapeA, shapeA.world, shapeB, shapeB.world);
+}
+
+OverlapingShape CollisionShape::intersectionExist(CollisionShape &shapeA, Transform &transformA, CollisionShape &shapeB, Transform &transformB){
+    return pairTests[shapeA.shapeType][shapeB.shapeType](shapeA, shapeA.computeWorld(transformA), shapeB, shapeB.computeWorld(transformB));
+}
+
+float CollisionShape::boundingRadius() const {
+    switch (shapeType) {
+        case SPHERE: return sphere.radius;
+        case AABB: return glm::length(aabb.diag);
+        case OOBB: return glm::length(world.oobb.halfExtents);
+        case COMPOUND:
+            if (!compound.data || compound.data->children.empty()) return FLT_MAX;
+            return glm::length(glm::max(glm::abs(compound.data->bounds.min), glm::abs(compound.data->bounds.max)));
+        default: return FLT_MAX;
     }
+}
+
+// half length of the shape projected on a unit axis
+static float projectedRadius(const CollisionShape &shape, const glm::vec3 &axis) {
+    switch (shape.shapeType) {
+        case SPHERE: return shape.sphere.radius;
+        case AABB: return fabs(axis.x) * shape.aabb.diag.x + fabs(axis.y) * shape.aabb.diag.y + fabs(axis.z) * shape.aabb.diag.z;
+        case OOBB: return projectedRadius(shape.world.oobb, axis);
+        default: return 0.f;
+    }
+}
+
+static int boxAxes(const CollisionShape &shape, glm::vec3 *axes) {
+    if (shape.shapeType == OOBB) {
+        for (int i = 0; i < 3; i++) axes[i] = shape.world.oobb.axes[i];
+        return 3;
+    }
+    if (shape.shapeType == AABB) {
+        axes[0] = {1, 0, 0};
+        axes[1] = {0, 1, 0};
+        axes[2] = {0, 0, 1};
+        return 3;
+    }
+    return 0;
+}
+
+// largest gap over a set of candidate separating axes: never more than the real distance
+static float separationLowerBound(const CollisionShape &moving, const glm::vec3 &center, const CollisionShape &target, glm::vec3 &normal) {
+    glm::vec3 axesA[3], axesB[3];
+    int countA = boxAxes(moving, axesA);
+    int countB = boxAxes(target, axesB);
+    glm::vec3 offset = center - target.world.position;
+
+    float best = -FLT_MAX;
+    auto testAxis = [&](glm::vec3 axis) {
+        float side = glm::dot(offset, axis);
+        if (side < 0.f) {
+            axis = -axis;
+            side = -side;
+        }
+        float gap = side - projectedRadius(moving, axis) - projectedRadius(target, axis);
+        if (gap > best) {
+            best = gap;
+            normal = axis;
+        }
+    };
+
+    float offsetLength = glm::length(offset);
+    if (offsetLength > 0.0001f) testAxis(offset / offsetLength);
+    for (int i = 0; i < countA; i++) testAxis(axesA[i]);
+    for (int i = 0; i < countB; i++) testAxis(axesB[i]);
+    for (int i = 0; i < countA; i++) {
+        for (int j = 0; j < countB; j++) {
+            glm::vec3 crossAxis = glm::cross(axesA[i], axesB[j]);
+            float length = glm::length(crossAxis);
+            if (length > 0.0001f) testAxis(crossAxis / length);
+        }
+    }
+    return best;
+}
+
+float CollisionShape::timeOfImpact(const CollisionShape &moving, const glm::vec3 &start, const glm::vec3 &displacement, const CollisionShape &target, glm::vec3 &normal) {
+    const float distance = glm::length(displacement);
+    if (distance < 0.0001f) return -1;
+
+    // planes are one sided, only what comes from the front is stopped
+    if (target.shapeType == PLANE) {
+        if (moving.shapeType != SPHERE) return -1;
+        const glm::vec3 &planeNormal = target.world.normal;
+        float gap = glm::dot(start - target.world.position, planeNormal) - projectedRadius(moving, planeNormal);
+        float approach = -glm::dot(displacement, planeNormal);
+        if (gap <= 0.f || approach <= 0.f || gap > approach) return -1;
+        normal = planeNormal;
+        return gap / approach;
+    }
+
+    // only the pairs the discrete tests know how to resolve
+    bool supported = (moving.shapeType == SPHERE && (target.shapeType == SPHERE || target.shapeType == AABB || target.shapeType == OOBB))
+        || (target.shapeType == SPHERE && (moving.shapeType == AABB || moving.shapeType == OOBB))
+        || (moving.shapeType == AABB && target.shapeType == AABB)
+        || (moving.shapeType == OOBB && target.shapeType == OOBB);
+    if (!supported) return -1;
+
+    // swept sphere against sphere, solved directly
+    if (moving.shapeType == SPHERE && target.shapeType == SPHERE) {
+        glm::vec3 offset = start - target.world.position;
+        float radiusSum = moving.sphere.radius + target.sphere.radius;
+        float c = glm::dot(offset, offset) - radiusSum * radiusSum;
+        float b = glm::dot(offset, displacement);
+        float a = glm::dot(displacement, displacement);
+        if (c <= 0.f || b >= 0.f) return -1;
+        float discriminant = b * b - a * c;
+        if (discriminant < 0.f) return -1;
+        float t = (-b - std::sqrt(discriminant)) / a;
+        if (t > 1.f) return -1;
+        normal = glm::normalize(offset + t * displacement);
+        return t;
+    }
+
+    // conservative advancement: the shapes can't get closer than the displacement length per unit of time,
+    // so moving by gap / distance never skips the contact
+    const float tolerance = 0.001f;
+    const int maxIterations = 32;
+
+    float t = 0.f;
+    float gap = separationLowerBound(moving, start, target, normal);
+    if (gap <= 0.f) return -1;
 
+    for (int i = 0; i < maxIterations; i++) {
+        if (gap <= tolerance) return glm::dot(displacement, normal) < 0.f ? t : -1;
+        t += gap / distance;
+        if (t > 1.f) return -1;
+        gap = separationLowerBound(moving, start + t * displacement, target, normal);
+    }
+    // not converged, a grazing pass: no contact was found, the discrete pass handles what is left
+    return -1;
+}
+
+static bool shapeBounds(const CollisionShape &shape, const WorldCollider &world, Bounds &bounds) {
+    switch (shape.shapeType) {
+        case SPHERE:
+            bounds = Bounds::fromCenter(world.position, glm::vec3(shape.sphere.radius));
+            return true;
+        case AABB:
+            bounds = Bounds::fromCenter(world.position, shape.aabb.diag);
+            return true;
+        case OOBB: {
+            glm::vec3 halfExtents(0);
+            for (int i = 0; i < 3; i++) halfExtents += glm::abs(world.oobb.axes[i]) * world.oobb.halfExtents[i];
+            bounds = Bounds::fromCenter(world.oobb.center, halfExtents);
+            return true;
+        }
+        case TRIANGLE_MESH:
+            if (!shape.triangleMesh.data) return false;
+            bounds = shape.triangleMesh.data->bounds.transformed(world.modelMatrix);
+            return true;
+        case HEIGHTFIELD:
+            if (!shape.heightfield.data) return false;
+            bounds = shape.heightfield.data->bounds.transformed(world.modelMatrix);
+            return true;
+        case COMPOUND:
+            if (!shape.compound.data || shape.compound.data->children.empty()) return false;
+            bounds = shape.compound.data->bounds.transformed(world.modelMatrix);
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool CollisionShape::worldBounds(Bounds &bounds) const {
+    return shapeBounds(*this, world, bounds);
+}
+
+static float rayBoxIntersection(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance, const glm::vec3 &center, const glm::vec3 *axes, const glm::vec3 &halfExtents, glm::vec3 &normal) {
+    float tMin = 0.f, tMax = maxDistance;
+    int hitAxis = -1;
+    float hitSign = 1.f;
+    glm::vec3 offset = center - origin;
+
+    for (int i = 0; i < 3; i++) {
+        float e = glm::dot(axes[i], offset);
+        float f = glm::dot(axes[i], direction);
+        if (fabs(f) > 1e-6f) {
+            float t1 = (e + halfExtents[i]) / f;
+            float t2 = (e - halfExtents[i]) / f;
+            // entering through the +axis face when going against the axis
+            float sign = 1.f;
+            if (t1 > t2) {
+                std::swap(t1, t2);
+                sign = -1.f;
+            }
+            if (t1 > tMin) {
+                tMin = t1;
+                hitAxis = i;
+                hitSign = sign;
+            }
+            tMax = std::min(tMax, t2);
+            if (tMin > tMax) return -1;
+        } else if (-e - halfExtents[i] > 0.f || -e + halfExtents[i] < 0.f) {
+            return -1;
+        }
+    }
+
+    // starting inside the box
+    if (hitAxis < 0) {
+        normal = -direction;
+        return 0.f;
+    }
+    normal = axes[hitAxis] * hitSign;
+    return tMin;
+}
+
+static float shapeRayIntersection(const CollisionShape &shape, const WorldCollider &world, const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance, glm::vec3 &normal) {
+    switch (shape.shapeType) {
+        case SPHERE: {
+            glm::vec3 offset = origin - world.position;
+            float b = glm::dot(offset, direction);
+            float c = glm::dot(offset, offset) - shape.sphere.radius * shape.sphere.radius;
+            if (c <= 0.f) {
+                normal = -direction;
+                return 0.f;
+            }
+            float discriminant = b * b - c;
+            if (b > 0.f || discriminant < 0.f) return -1;
+            float t = -b - std::sqrt(discriminant);
+            if (t > maxDistance) return -1;
+            normal = glm::normalize(offset + t * direction);
+            return t;
+        }
+        case PLANE: {
+            float nd = glm::dot(direction, world.normal);
+            if (nd >= 0.f) return -1;
+            float t = glm::dot(world.normal, world.position - origin) / nd;
+            if (t < 0.f || t > maxDistance) return -1;
+            normal = world.normal;
+            return t;
+        }
+        case AABB: {
+            const glm::vec3 axes[3] = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}};
+            return rayBoxIntersection(origin, direction, maxDistance, world.position, axes, shape.aabb.diag, normal);
+        }
+        case OOBB:
+            return rayBoxIntersection(origin, direction, maxDistance, world.oobb.center, world.oobb.axes, world.oobb.halfExtents, normal);
+        case TRIANGLE_MESH:
+        case HEIGHTFIELD:
+            return meshRayIntersection(shape, world, origin, direction, maxDistance, normal);
+        case COMPOUND: {
+            if (!shape.compound.data) return -1;
+            const CompoundShapeData &data = *shape.compound.data;
+            // the local direction isn't normalized so t is the same in both spaces
+            glm::vec3 localOrigin = glm::vec3(world.invModelMatrix * glm::vec4(origin, 1.f));
+            glm::vec3 localDirection = glm::vec3(world.invModelMatrix * glm::vec4(direction, 0.f));
+            float best = -1;
+            data.tree.raycast(localOrigin, localDirection, maxDistance, [&](uint32_t index, float maxT) {
+                const CompoundChild &child = data.children[index];
+                // triggers don't stop rays
+                if (child.trigger) return maxT;
+                glm::vec3 childNormal;
+                float t = shapeRayIntersection(child.shape, child.shape.computeWorld(world.modelMatrix * child.localMatrix), origin, direction, maxT, childNormal);
+                if (t < 0.f || (best >= 0.f && t >= best)) return maxT;
+                best = t;
+                normal = childNormal;
+                return t;
+            });
+            return best;
+        }
+        default:
+            return -1;
+    }
+}
+
+float CollisionShape::rayIntersection(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance, glm::vec3 &normal) const {
+    return shapeRayIntersection(*this, world, origin, direction, maxDistance, normal);
+}
+
+std::map<std::string, CompoundShapeData> CompoundShapeData::compounds;
+
+CompoundShapeData& CompoundShapeData::create(const std::string &key) {
+    CompoundShapeData &res = compounds[key];
+    res.children.clear();
+    res.tree.clear();
     return res;
 }
 
+void CompoundShapeData::addChild(CollisionShape &&shape, const glm::vec3 &position, const glm::quat &rotation) {
+    assert(shape.shapeType != RAY && shape.shapeType != PLANE && shape.shapeType != COMPOUND && "Compound children must be bounded primitives or meshes.");
+    children.push_back({std::move(shape), glm::translate(glm::mat4(1.f), position) * glm::mat4_cast(rotation)});
+}
+
+void CompoundShapeData::addTrigger(CollisionShape &&shape, const glm::vec3 &position) {
+    addChild(std::move(shape), position);
+    children.back().trigger = true;
+}
+
+void CompoundShapeData::build() {
+    std::vector<Bounds> childBounds(children.size());
+    std::vector<uint32_t> indices(children.size());
+    for (uint32_t i = 0; i < children.size(); i++) {
+        const CollisionShape &shape = children[i].shape;
+        if (shape.shapeType == AABB) {
+            // stays axis aligned in world space whatever the compound rotation
+            childBounds[i] = Bounds::fromCenter(glm::vec3(children[i].localMatrix[3]), glm::vec3(glm::length(shape.aabb.diag)));
+        } else {
+            shapeBounds(shape, shape.computeWorld(children[i].localMatrix), childBounds[i]);
+        }
+        indices[i] = i;
+        bounds = i == 0 ? childBounds[i] : bounds.merged(childBounds[i]);
+    }
+    tree.build(childBounds, indices);
+}
+
 uint16_t CollisionShape::ENV_LAYER = 1 << 0;
 uint16_t CollisionShape::PLAYER_LAYER = 1 << 1;
 uint16_t CollisionShape::GRAVITY_SENSITIVE_LAYER = 1 << 2;
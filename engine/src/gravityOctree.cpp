@@ -0,0 +1,135 @@
+#include <engine/include/gravityOctree.hpp>
+
+#include <algorithm>
+#include <cfloat>
+
+void GravityOctree::clear() {
+    nodes.clear();
+    positions.clear();
+    masses.clear();
+}
+
+void GravityOctree::build(const std::vector<glm::vec3> &sourcePositions, const std::vector<float> &sourceMasses) {
+    clear();
+    if (sourcePositions.empty()) return;
+
+    positions = sourcePositions;
+    masses = sourceMasses;
+
+    glm::vec3 min(FLT_MAX), max(-FLT_MAX);
+    for (auto &position : positions) {
+        min = glm::min(min, position);
+        max = glm::max(max, position);
+    }
+    glm::vec3 extent = max - min;
+    float halfSize = std::max(std::max(extent.x, extent.y), std::max(extent.z, 1e-3f)) * 0.5f;
+
+    nodes.reserve(2 * positions.size());
+    nodes.push_back({glm::vec3(0), 0.f, (min + max) * 0.5f, halfSize, 0, (uint32_t) positions.size(), true});
+
+    struct BuildTask { uint32_t node; int depth; };
+    std::vector<BuildTask> tasks = {{0, 0}};
+    std::vector<glm::vec3> sortedPositions(positions.size());
+    std::vector<float> sortedMasses(positions.size());
+    std::vector<uint8_t> octants(positions.size());
+
+    while (!tasks.empty()) {
+        BuildTask task = tasks.back();
+        tasks.pop_back();
+        // copies, the node may be reallocated by the push_back below
+        const uint32_t first = nodes[task.node].first;
+        const uint32_t count = nodes[task.node].count;
+        const glm::vec3 center = nodes[task.node].center;
+        const float nodeHalfSize = nodes[task.node].halfSize;
+
+        float mass = 0.f;
+        glm::vec3 weighted(0);
+        for (uint32_t i = first; i < first + count; i++) {
+            mass += masses[i];
+            weighted += masses[i] * positions[i];
+        }
+        nodes[task.node].mass = mass;
+        nodes[task.node].centerOfMass = mass > 0.f ? weighted / mass : center;
+
+        if (count <= (uint32_t) MAX_LEAF_SIZE || task.depth >= MAX_DEPTH) continue;
+
+        // counting sort of the range by octant
+        uint32_t octantCounts[8] = {};
+        for (uint32_t i = first; i < first + count; i++) {
+            const glm::vec3 &p = positions[i];
+            uint8_t octant = (p.x >= center.x ? 1 : 0) | (p.y >= center.y ? 2 : 0) | (p.z >= center.z ? 4 : 0);
+            octants[i] = octant;
+            octantCounts[octant]++;
+        }
+        uint32_t offsets[8];
+        uint32_t offset = first;
+        for (int octant = 0; octant < 8; octant++) {
+            offsets[octant] = offset;
+            offset += octantCounts[octant];
+        }
+        for (uint32_t i = first; i < first + count; i++) {
+            uint32_t target = offsets[octants[i]]++;
+            sortedPositions[target] = positions[i];
+            sortedMasses[target] = masses[i];
+        }
+        std::copy(sortedPositions.begin() + first, sortedPositions.begin() + first + count, positions.begin() + first);
+        std::copy(sortedMasses.begin() + first, sortedMasses.begin() + first + count, masses.begin() + first);
+
+        // non empty children are contiguous
+        uint32_t firstChild = nodes.size();
+        uint32_t childFirst = first;
+        float childHalfSize = nodeHalfSize * 0.5f;
+        for (int octant = 0; octant < 8; octant++) {
+            if (octantCounts[octant] == 0) continue;
+            glm::vec3 childCenter = center + childHalfSize * glm::vec3(octant & 1 ? 1.f : -1.f, octant & 2 ? 1.f : -1.f, octant & 4 ? 1.f : -1.f);
+            tasks.push_back({(uint32_t) nodes.size(), task.depth + 1});
+            nodes.push_back({glm::vec3(0), 0.f, childCenter, childHalfSize, childFirst, octantCounts[octant], true});
+            childFirst += octantCounts[octant];
+        }
+        nodes[task.node].first = firstChild;
+        nodes[task.node].count = nodes.size() - firstChild;
+        nodes[task.node].leaf = false;
+    }
+}
+
+glm::vec3 GravityOctree::pull(const glm::vec3 &offset, float mass) const {
+    float distanceSq = glm::dot(offset, offset) + softening * softening;
+    if (distanceSq <= 0.f) return glm::vec3(0);
+    float invDistance = 1.f / std::sqrt(distanceSq);
+    return (gravitationalConstant * mass * invDistance * invDistance * invDistance) * offset;
+}
+
+glm::vec3 GravityOctree::field(const glm::vec3 &point, float theta) const {
+    glm::vec3 res(0);
+    if (nodes.empty()) return res;
+
+    const float thetaSq = theta * theta;
+    uint32_t stack[STACK_SIZE];
+    int count = 0;
+    stack[count++] = 0;
+
+    while (count > 0) {
+        const Node &node = nodes[stack[--count]];
+        glm::vec3 offset = node.centerOfMass - point;
+
+        if (node.leaf) {
+            for (uint32_t i = node.first; i < node.first + node.count; i++) res += pull(positions[i] - point, masses[i]);
+            continue;
+        }
+
+        float size = 2.f * node.halfSize;
+        if (size * size < thetaSq * glm::dot(offset, offset)) {
+            res += pull(offset, node.mass);
+            continue;
+        }
+
+        for (uint32_t child = node.first; child < node.first + node.count; child++) stack[count++] = child;
+    }
+    return res;
+}
+
+glm::vec3 GravityOctree::exactField(const glm::vec3 &point) const {
+    glm::vec3 res(0);
+    for (size_t i = 0; i < positions.size(); i++) res += pull(positions[i] - point, masses[i]);
+    return res;
+}
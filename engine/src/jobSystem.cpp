@@ -0,0 +1,126 @@
+#include <engine/include/jobSystem.hpp>
+
+#include <algorithm>
+
+JobSystem& JobSystem::getInstance() {
+    static JobSystem instance;
+    return instance;
+}
+
+JobSystem::JobSystem() {
+    unsigned hardware = std::thread::hardware_concurrency();
+    setWorkerCount(hardware == 0 ? 1 : hardware);
+}
+
+JobSystem::~JobSystem() {
+    stopThreads();
+}
+
+void JobSystem::setWorkerCount(unsigned count) {
+    count = std::max(1u, count);
+    if (count == workerCount && threads.size() + 1 == count) return;
+
+    stopThreads();
+    workerCount = count;
+    startThreads();
+}
+
+void JobSystem::startThreads() {
+    stopping = false;
+    // the calling thread is a worker too
+    for (unsigned i = 1; i < workerCount; i++) {
+        threads.emplace_back(&JobSystem::workerLoop, this);
+    }
+}
+
+void JobSystem::stopThreads() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeCondition.notify_all();
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    threads.clear();
+}
+
+unsigned JobSystem::chunkCount(size_t count, size_t minChunkSize) const {
+    if (count == 0) return 0;
+    minChunkSize = std::max<size_t>(1, minChunkSize);
+    size_t chunks = (count + minChunkSize - 1) / minChunkSize;
+    // a few chunks per worker so an uneven chunk doesn't stall the others
+    return (unsigned) std::min<size_t>(chunks, workerCount * 4);
+}
+
+void JobSystem::runChunks(const RangeFunction &fn, size_t count, unsigned chunks) {
+    while (true) {
+        unsigned chunk = nextChunk.fetch_add(1);
+        if (chunk >= chunks) return;
+
+        size_t begin = count * chunk / chunks;
+        size_t end = count * (chunk + 1) / chunks;
+        fn(begin, end, chunk);
+
+        finishedChunks.fetch_add(1);
+    }
+}
+
+void JobSystem::workerLoop() {
+    uint64_t seenGeneration = 0;
+    while (true) {
+        const RangeFunction *fn;
+        size_t count;
+        unsigned chunks;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeCondition.wait(lock, [&] { return stopping || generation != seenGeneration; });
+            if (stopping) return;
+            seenGeneration = generation;
+            // woken after its caller returned, the job is gone
+            if (!job) continue;
+            // the caller waits for activeWorkers to drop to 0 before the job can change
+            fn = job;
+            count = jobCount;
+            chunks = jobChunks;
+            activeWorkers++;
+        }
+        runChunks(*fn, count, chunks);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            activeWorkers--;
+        }
+        doneCondition.notify_all();
+    }
+}
+
+void JobSystem::parallelFor(size_t count, size_t minChunkSize, const RangeFunction &fn) {
+    unsigned chunks = chunkCount(count, minChunkSize);
+    if (chunks == 0) return;
+
+    std::unique_lock<std::mutex> jobLock(jobMutex, std::defer_lock);
+    if (chunks == 1 || threads.empty() || !jobLock.try_lock()) {
+        for (unsigned chunk = 0; chunk < chunks; chunk++) {
+            fn(count * chunk / chunks, count * (chunk + 1) / chunks, chunk);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = &fn;
+        jobCount = count;
+        jobChunks = chunks;
+        nextChunk = 0;
+        finishedChunks = 0;
+        generation++;
+    }
+    wakeCondition.notify_all();
+
+    runChunks(fn, count, chunks);
+
+    // workers still inside runChunks could otherwise pick chunks of the next job
+    std::unique_lock<std::mutex> lock(mutex);
+    doneCondition.wait(lock, [&] { return finishedChunks.load() == jobChunks && activeWorkers == 0; });
+    job = nullptr;
+}
@@ -2,6 +2,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <vector>
+#include <algorithm>
 #include <iostream>
 
 // Include GLEW
@@ -33,6 +34,7 @@ using namespace glm;
 #include <engine/include/spatial.hpp>
 #include <engine/include/stbi.h>
 #include <engine/include/scene.hpp>
+#include <engine/include/physicThread.hpp>
 #include <imgui.h>
 #include <backend/imgui_impl_opengl3.h>
 #include <common/json.hpp>
@@ -60,6 +62,16 @@ int screenWidth,screenHeight;
 float deltaTime = 0.0f;	// time between current frame and last frame
 float lastFrame = 0.0f;
 
+// physic runs at a fixed rate, independent from the frame rate
+float physicRate = 60.f;
+int maxPhysicSteps = 5; // per frame, avoids the spiral of death when a step costs more than it simulates
+bool interpolatePhysic = true;
+float physicAccumulator = 0.f;
+// steps run on the physic thread while the frame renders
+bool threadedPhysic = false;
+bool showPhysicStats = false;
+bool showRenderStats = false;
+
 //rotation
 float angle = 0.;
 float zoom = 1.;
@@ -67,8 +79,7 @@ float zoom = 1.;
 
 bool isInEditor = true;
 
-// SceneGraph scene;
-SpatialNode root;
+SceneGraph sceneGraph;
 
 // ecs
 ecsManager ecs;
@@ -80,7 +91,13 @@ std::shared_ptr<CameraSystem> cameraSystem;
 std::shared_ptr<CustomSystem> customSystem;
 std::shared_ptr<CollisionDetectionSystem> collisionDetectionSystem;
 std::shared_ptr<PhysicSystem> physicSystem;
+std::shared_ptr<GravityFieldSystem> gravityFieldSystem;
+std::shared_ptr<OrbitSystem> orbitSystem;
 std::shared_ptr<PhysicDebugSystem> physicDebugSystem;
+std::shared_ptr<BoundsSystem> boundsSystem;
+std::shared_ptr<AnimatedBoundsSystem> animatedBoundsSystem;
+// camera view of the frame
+VisibleSet mainView;
 
 
 void initEcs(){
@@ -97,6 +114,8 @@ void initEcs(){
     ecs.RegisterComponent<CustomBehavior>("CustomBehavior");
     ecs.RegisterComponent<RigidBody>("RigidBody");
     ecs.RegisterComponent<CollisionShape>("CollisionShape");
+    ecs.RegisterComponent<GravitySource>("GravitySource");
+    ecs.RegisterComponent<Orbit>("Orbit");
 
     renderSystem = ecs.RegisterSystem<Render>();
     pbrRenderSystem = ecs.RegisterSystem<PBRrender>();
@@ -106,7 +125,14 @@ void initEcs(){
     customSystem = ecs.RegisterSystem<CustomSystem>();
     collisionDetectionSystem = ecs.RegisterSystem<CollisionDetectionSystem>();
     physicSystem = ecs.RegisterSystem<PhysicSystem>();
+    gravityFieldSystem = ecs.RegisterSystem<GravityFieldSystem>();
+    physicSystem->gravityField = gravityFieldSystem.get();
+    orbitSystem = ecs.RegisterSystem<OrbitSystem>();
+    orbitSystem->sceneGraph = &sceneGraph;
     physicDebugSystem = ecs.RegisterSystem<PhysicDebugSystem>();
+    boundsSystem = ecs.RegisterSystem<BoundsSystem>();
+    animatedBoundsSystem = ecs.RegisterSystem<AnimatedBoundsSystem>();
+    boundsSystem->animated = animatedBoundsSystem.get();
     physicDebugSystem->init();
     
     Signature renderSignature;
@@ -152,15 +178,35 @@ void initEcs(){
     physicSignature.set(ecs.GetComponentType<CollisionShape>());        
     ecs.SetSystemSignature<PhysicSystem>(physicSignature);
 
+    Signature gravityFieldSignature;
+    gravityFieldSignature.set(ecs.GetComponentType<Transform>());
+    gravityFieldSignature.set(ecs.GetComponentType<GravitySource>());
+    ecs.SetSystemSignature<GravityFieldSystem>(gravityFieldSignature);
+
+    Signature orbitSignature;
+    orbitSignature.set(ecs.GetComponentType<Transform>());
+    orbitSignature.set(ecs.GetComponentType<Orbit>());
+    ecs.SetSystemSignature<OrbitSystem>(orbitSignature);
+
     Signature physicDebugSignature;
     physicDebugSignature.set(ecs.GetComponentType<Transform>());        
     physicDebugSignature.set(ecs.GetComponentType<CollisionShape>());        
     ecs.SetSystemSignature<PhysicDebugSystem>(physicDebugSignature);
+
+    Signature boundsSignature;
+    boundsSignature.set(ecs.GetComponentType<Transform>());
+    boundsSignature.set(ecs.GetComponentType<Drawable>());
+    ecs.SetSystemSignature<BoundsSystem>(boundsSignature);
+
+    Signature animatedBoundsSignature;
+    animatedBoundsSignature.set(ecs.GetComponentType<Transform>());
+    animatedBoundsSignature.set(ecs.GetComponentType<AnimatedDrawable>());
+    ecs.SetSystemSignature<AnimatedBoundsSystem>(animatedBoundsSignature);
 }
 
 
 void unloadScene(){
-    root.destroy();
+    sceneGraph.clear();
     ecs.DestroyAllEntities();
     Program::destroyPrograms();
 }
@@ -168,7 +214,9 @@ void unloadScene(){
 void afterSceneInit(){
     pbrRenderSystem->initPBR();
 
-    root.updateSelfAndChildTransform();
+    sceneGraph.updateTransforms();
+    boundsSystem->update();
+    collisionDetectionSystem->buildStaticTree();
 
     Program *pbr = Program::programs.back().get();
 
@@ -205,7 +253,7 @@ void afterSceneInit(){
 
     CubemapRender sceneCubemapRender(256);
     // Render scene into a cubemap
-    sceneCubemapRender.renderFromPoint({0,0,0}, renderSystem.get(), pbrRenderSystem.get());
+    sceneCubemapRender.renderFromPoint({0,0,0}, renderSystem.get(), pbrRenderSystem.get(), boundsSystem.get());
     
     ///////////////////////// diffuse irradiance
     auto irradianceShader = std::make_unique<IrradianceShader>();        
@@ -244,8 +292,7 @@ void afterSceneInit(){
     ecs.AddComponent<Drawable>(testCubemapRenderEntity, cubemapDraw);
     ecs.AddComponent<CustomProgram>(testCubemapRenderEntity, cubemapProg);
 
-    std::unique_ptr<SpatialNode> cubemapNode = std::make_unique<SpatialNode>(&ecs.GetComponent<Transform>(testCubemapRenderEntity));
-    root.AddChild(std::move(cubemapNode));
+    sceneGraph.add(testCubemapRenderEntity);
 }
 
 void switchEditorMode(){
@@ -254,12 +301,66 @@ void switchEditorMode(){
     
     isInEditor = !isInEditor;
     Camera::editor = isInEditor;
+    // the inspector moves the bodies directly while the physic is paused, nothing to interpolate from
+    if(!isInEditor){
+        for(auto entity: physicSystem->mEntities) ecs.GetComponent<RigidBody>(entity).hasPreviousPosition = false;
+    }
     
     Camera::getInstance().camera_target = target;
     Camera::getInstance().camera_position = position;
 }
 
+void renderStatsWindow(){
+    if(ImGui::Begin("Render stats", &showRenderStats)){
+        ImGui::SeparatorText("Culling");
+        ImGui::Text("Tested %zu, drawn %zu, culled %zu", mainView.tested, mainView.entities.size(), mainView.culled);
+        ImGui::Text("Bounds refreshed %zu", boundsSystem->getRefreshCount());
+        ImGui::SeparatorText("PBR");
+        ImGui::Text("Draw calls %zu for %zu drawables", pbrRenderSystem->getDrawCalls(), pbrRenderSystem->getDrawnItems());
+        int minInstances = pbrRenderSystem->minInstances;
+        if(ImGui::DragInt("Min instances", &minInstances, 1, 2, 64)) pbrRenderSystem->minInstances = minInstances;
+    }
+    ImGui::End();
+}
+
+// last physic step, read while no step runs
+void physicStatsWindow(){
+    static const char *shapeNames[COLLISION_SHAPE_TYPE_COUNT] = {"Ray", "Sphere", "Plane", "AABB", "OOBB", "Mesh", "Heightfield", "Compound"};
+    const auto &collision = collisionDetectionSystem->getStats();
+    const auto &physic = physicSystem->getStats();
+
+    if(ImGui::Begin("Physic stats", &showPhysicStats)){
+        ImGui::SeparatorText("Bodies");
+        ImGui::Text("Rigid %zu, kinematic %zu, static %zu", physic.rigidBodies, physic.kinematicBodies, physic.staticBodies);
+
+        ImGui::SeparatorText("Collision");
+        ImGui::Text("Proxies %zu, unbounded %zu", collision.proxies, collision.unbounded);
+        ImGui::Text("Candidate pairs %zu, rejected by layer %zu", collision.candidatePairs, collision.layerRejectedPairs);
+        for(int a=0; a<COLLISION_SHAPE_TYPE_COUNT; a++){
+            for(int b=a; b<COLLISION_SHAPE_TYPE_COUNT; b++){
+                if(collision.narrowTests[a][b] > 0) ImGui::BulletText("%s - %s: %zu", shapeNames[a], shapeNames[b], collision.narrowTests[a][b]);
+            }
+        }
+        ImGui::Text("Contacts %zu", collision.contacts);
+
+        ImGui::SeparatorText("Solver");
+        ImGui::Text("Contacts %zu in %zu colors, %zu serial", physic.solvedContacts, physic.colors, physic.serialContacts);
+        ImGui::Text("Iterations %d, residual %.4f", physic.solverIterations, physic.solverResidual);
+
+        ImGui::SeparatorText("Time (ms)");
+        ImGui::Text("Broad phase %.3f", collision.broadPhaseTime);
+        ImGui::Text("Narrow phase %.3f", collision.narrowPhaseTime);
+        ImGui::Text("Prepare %.3f", physic.prepareTime);
+        ImGui::Text("Solver %.3f", physic.solverTime);
+        ImGui::Text("Correction %.3f", physic.correctionTime);
+        ImGui::Text("Integration %.3f", physic.integrationTime);
+    }
+    ImGui::End();
+}
+
 void editorUpdate(float deltaTime){
+    if(showPhysicStats) physicStatsWindow();
+    if(showRenderStats) renderStatsWindow();
     if(ImGui::Begin("Scene", nullptr, ImGuiWindowFlags_NoCollapse)) {
         if(ImGui::Begin("Shaders")){
             for(auto &prog: Program::programs){
@@ -270,17 +371,26 @@ void editorUpdate(float deltaTime){
 
         if (ImGui::Button("Switch mode")) switchEditorMode();
 
+        ImGui::DragFloat("Physic rate (Hz)", &physicRate, 1.f, 10.f, 240.f, "%.0f", ImGuiSliderFlags_AlwaysClamp);
+        ImGui::DragInt("Max physic steps", &maxPhysicSteps, 1, 1, 20);
+        ImGui::Checkbox("Interpolate physic", &interpolatePhysic);
+        ImGui::Checkbox("Physic thread", &threadedPhysic);
+        ImGui::Checkbox("Physic stats", &showPhysicStats);
+        ImGui::Checkbox("Render stats", &showRenderStats);
+        ImGui::SliderFloat("Gravity field theta", &gravityFieldSystem->theta, 0.f, 1.5f);
+        ImGui::Checkbox("Exact gravity field", &gravityFieldSystem->exact);
+
         if (ImGui::Button("Load scene 1")){
             unloadScene();
-            initScene(root, ecs);
+            initScene(sceneGraph, ecs);
             afterSceneInit();
         } else if(ImGui::Button("Load scene 2")){
             unloadScene();
-            pbrScene(root, ecs);
+            pbrScene(sceneGraph, ecs);
             afterSceneInit();
         } else if(ImGui::Button("Load scene physic")){
             unloadScene();
-            physicScene(root, ecs);
+            physicScene(sceneGraph, ecs);
             afterSceneInit();
         }
 
@@ -308,27 +418,106 @@ void editorUpdate(float deltaTime){
     Camera::getInstance().updateInput(deltaTime);
     glm::mat4 view = Camera::getInstance().getV();
     collisionDetectionSystem->update(deltaTime);
+    boundsSystem->update();
+    glm::mat4 projection = Camera::getInstance().getP();
+    CameraUniforms::set(view, projection);
+    boundsSystem->cull(projection * view, mainView);
     lightRenderSystem->update();
-    renderSystem->update(view);
-    pbrRenderSystem->update(view);
-    animatedPbrRenderSystem->update(view, deltaTime);
+    renderSystem->update(&mainView);
+    pbrRenderSystem->update(&mainView);
+    animatedPbrRenderSystem->update(deltaTime, &mainView);
     
     physicDebugSystem->update();
 
     if(savePicture)  save_PPM_file(SCR_WIDTH, SCR_HEIGHT, "../pictures/scene.ppm");
 }
 
+void runPhysicStep(float physicStep){
+    // commands first, a teleport must reach the model matrices before the colliders are refreshed;
+    // then the transforms moved by the commands and the previous step
+    PhysicThread::getInstance().applyCommands(physicStep);
+    sceneGraph.updateTransforms();
+    collisionDetectionSystem->update(physicStep);
+    physicSystem->update(physicStep);
+}
+
+// the frame renders the moving bodies and their children from the published poses while the steps run
+void kickPhysicThread(int steps, float physicStep, float alpha){
+    auto &physicThread = PhysicThread::getInstance();
+    // only the physic subtrees become dirty during the job
+    sceneGraph.updateTransforms();
+
+    std::unordered_set<const Transform*> bodies;
+    for(auto entity: physicSystem->mEntities){
+        if(ecs.GetComponent<RigidBody>(entity).type != RigidBody::STATIC) bodies.insert(&ecs.GetComponent<Transform>(entity));
+    }
+    std::vector<Transform*> moving;
+    sceneGraph.collectSubtrees(bodies, moving);
+
+    // the bounds follow the published poses, the job owns the moving transforms until the next wait()
+    if(interpolatePhysic){
+        physicSystem->applyInterpolation(alpha);
+        sceneGraph.updateTransforms();
+        boundsSystem->update();
+        physicThread.publishPoses(moving);
+        physicSystem->removeInterpolation();
+        sceneGraph.updateTransforms();
+    } else {
+        boundsSystem->update();
+        physicThread.publishPoses(moving);
+    }
+
+    physicThread.kick([steps, physicStep](){
+        for(int i=0; i<steps; i++) runPhysicStep(physicStep);
+        sceneGraph.updateTransforms();
+    });
+}
+
+void physicUpdate(float deltaTime){
+    // the rate is edited in the UI, a null one would make the step infinite
+    const float physicStep = 1.f / std::max(physicRate, 1.f);
+    physicAccumulator += deltaTime;
+
+    int steps = 0;
+    while(physicAccumulator >= physicStep && steps < maxPhysicSteps){
+        physicAccumulator -= physicStep;
+        steps++;
+    }
+    // too far behind: drop what can't be caught up
+    if(physicAccumulator >= physicStep) physicAccumulator = std::fmod(physicAccumulator, physicStep);
+    float alpha = physicAccumulator / physicStep;
+
+    if(threadedPhysic){
+        kickPhysicThread(steps, physicStep, alpha);
+        return;
+    }
+
+    for(int i=0; i<steps; i++) runPhysicStep(physicStep);
+
+    if(interpolatePhysic){
+        physicSystem->applyInterpolation(alpha);
+        sceneGraph.updateTransforms();
+    }
+    boundsSystem->update();
+}
+
 void gameUpdate(float deltaTime){
     glm::mat4 view = Camera::getInstance().getV();
+    if(showPhysicStats) physicStatsWindow();
+    if(showRenderStats) renderStatsWindow();
 
     customSystem->update(deltaTime);
     cameraSystem->update();
-    collisionDetectionSystem->update(deltaTime);
-    physicSystem->update(deltaTime);
+    orbitSystem->update(deltaTime, Camera::getInstance().getPosition());
+    physicUpdate(deltaTime);
+    glm::mat4 projection = Camera::getInstance().getP();
+    CameraUniforms::set(view, projection);
+    boundsSystem->cull(projection * view, mainView);
     lightRenderSystem->update();
-    renderSystem->update(view);
-    pbrRenderSystem->update(view);
-    animatedPbrRenderSystem->update(view, deltaTime);
+    renderSystem->update(&mainView);
+    pbrRenderSystem->update(&mainView);
+    animatedPbrRenderSystem->update(deltaTime, &mainView);
+    if(interpolatePhysic && !threadedPhysic) physicSystem->removeInterpolation();
 }
 
 int main( void )
@@ -392,7 +581,7 @@ int main( void )
         initEcs();
         auto actions = InputManager::getInstance().getActions();
 
-        initScene(root, ecs);
+        initScene(sceneGraph, ecs);
     
         afterSceneInit();
 
@@ -416,6 +605,7 @@ int main( void )
             auto frameStart = std::chrono::high_resolution_clock::now();
             deltaTime = currentFrame - lastFrame;
             lastFrame = currentFrame;
+            CameraUniforms::setTime(currentFrame);
 
             // input
             InputManager::getInstance().processInput(window);
@@ -424,7 +614,9 @@ int main( void )
             
             // Clear the screen
             glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-            root.updateSelfAndChildTransform();
+            // steps kicked last frame must be done before anything touches the transforms
+            PhysicThread::getInstance().wait();
+            sceneGraph.updateTransforms();
 
             if(actions[InputManager::EDITOR_SWITCH_MODE].clicked) switchEditorMode();
 
@@ -449,6 +641,7 @@ int main( void )
         } // Check if the ESC key was pressed or the window was closed
         while( !actions[InputManager::ActionEnum::KEY_ESCAPE].clicked &&
                glfwWindowShouldClose(window) == 0 );
+        PhysicThread::getInstance().wait();
     
         // scene.clear();
         ImGui_ImplOpenGL3_Shutdown();
@@ -0,0 +1,293 @@
+#include <engine/include/meshCollider.hpp>
+#include <engine/include/stbi.h>
+
+#include <cfloat>
+#include <cmath>
+#include <iostream>
+
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+#include <assimp/Importer.hpp>
+
+std::map<std::string, TriangleMeshData> TriangleMeshData::meshes;
+std::map<std::string, HeightfieldData> HeightfieldData::heightfields;
+
+float rayTriangleIntersection(const glm::vec3 &origin, const glm::vec3 &direction, const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c, float maxT) {
+    glm::vec3 edge1 = b - a;
+    glm::vec3 edge2 = c - a;
+    glm::vec3 p = glm::cross(direction, edge2);
+    float determinant = glm::dot(edge1, p);
+    if (std::fabs(determinant) < 1e-8f) return -1;
+
+    float invDeterminant = 1.f / determinant;
+    glm::vec3 offset = origin - a;
+    float u = glm::dot(offset, p) * invDeterminant;
+    if (u < 0.f || u > 1.f) return -1;
+
+    glm::vec3 q = glm::cross(offset, edge1);
+    float v = glm::dot(direction, q) * invDeterminant;
+    if (v < 0.f || u + v > 1.f) return -1;
+
+    float t = glm::dot(edge2, q) * invDeterminant;
+    if (t < 0.f || t > maxT) return -1;
+    return t;
+}
+
+// normal of the triangle facing the ray
+static glm::vec3 hitNormal(const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c, const glm::vec3 &direction) {
+    glm::vec3 normal = glm::normalize(glm::cross(b - a, c - a));
+    return glm::dot(normal, direction) > 0.f ? -normal : normal;
+}
+
+////////////  Triangle mesh
+
+void TriangleMeshData::quantize(const Bounds &box, uint16_t *min, uint16_t *max) const {
+    for (int i = 0; i < 3; i++) {
+        // rounded outward so the quantized box always contains the real one
+        float low = std::floor((box.min[i] - bounds.min[i]) * quantizationScale[i]);
+        float high = std::ceil((box.max[i] - bounds.min[i]) * quantizationScale[i]);
+        min[i] = (uint16_t) std::max(0.f, std::min(65535.f, low));
+        max[i] = (uint16_t) std::max(0.f, std::min(65535.f, high));
+    }
+}
+
+void TriangleMeshData::build() {
+    nodes.clear();
+    uint32_t count = triangleCount();
+    if (count == 0) return;
+
+    bounds = Bounds(glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX));
+    for (auto &vertex : vertices) bounds = bounds.merged(Bounds(vertex, vertex));
+    glm::vec3 size = bounds.extents();
+    for (int i = 0; i < 3; i++) quantizationScale[i] = size[i] > 0.f ? 65535.f / size[i] : 0.f;
+
+    std::vector<uint32_t> triangles(count);
+    std::vector<Bounds> triangleBounds(count);
+    for (uint32_t i = 0; i < count; i++) {
+        glm::vec3 a, b, c;
+        getTriangle(i, a, b, c);
+        triangles[i] = i;
+        triangleBounds[i] = Bounds(glm::min(a, glm::min(b, c)), glm::max(a, glm::max(b, c)));
+    }
+
+    nodes.reserve(2 * count / MAX_LEAF_SIZE + 1);
+    buildNode(triangles, triangleBounds, 0, count);
+
+    // triangles in leaf order, so a leaf is a contiguous range
+    std::vector<uint32_t> sortedIndices(indices.size());
+    for (uint32_t i = 0; i < count; i++) {
+        for (int k = 0; k < 3; k++) sortedIndices[3 * i + k] = indices[3 * triangles[i] + k];
+    }
+    indices = std::move(sortedIndices);
+}
+
+// median split along the largest axis of the triangles' centers, nodes written depth first
+void TriangleMeshData::buildNode(std::vector<uint32_t> &triangles, std::vector<Bounds> &triangleBounds, uint32_t first, uint32_t count) {
+    uint32_t index = nodes.size();
+    nodes.emplace_back();
+
+    Bounds nodeBounds = triangleBounds[triangles[first]];
+    Bounds centers(nodeBounds.center(), nodeBounds.center());
+    for (uint32_t i = first + 1; i < first + count; i++) {
+        nodeBounds = nodeBounds.merged(triangleBounds[triangles[i]]);
+        glm::vec3 center = triangleBounds[triangles[i]].center();
+        centers = centers.merged(Bounds(center, center));
+    }
+    quantize(nodeBounds, nodes[index].min, nodes[index].max);
+
+    if (count <= (uint32_t) MAX_LEAF_SIZE) {
+        nodes[index].data = LEAF_FLAG | first << 3 | count;
+        return;
+    }
+
+    glm::vec3 spread = centers.extents();
+    int axis = spread.x > spread.y ? (spread.x > spread.z ? 0 : 2) : (spread.y > spread.z ? 1 : 2);
+    uint32_t half = count / 2;
+    std::nth_element(triangles.begin() + first, triangles.begin() + first + half, triangles.begin() + first + count,
+        [&](uint32_t a, uint32_t b) { return triangleBounds[a].center()[axis] < triangleBounds[b].center()[axis]; });
+
+    buildNode(triangles, triangleBounds, first, half);
+    buildNode(triangles, triangleBounds, first + half, count - half);
+    nodes[index].data = nodes.size();
+}
+
+float TriangleMeshData::raycast(const glm::vec3 &origin, const glm::vec3 &direction, float maxT, glm::vec3 &normal) const {
+    if (nodes.empty()) return -1;
+
+    glm::vec3 invDirection = 1.f / direction;
+    glm::vec3 invScale;
+    for (int i = 0; i < 3; i++) invScale[i] = quantizationScale[i] > 0.f ? 1.f / quantizationScale[i] : 0.f;
+
+    float best = -1;
+    uint32_t index = 0;
+    while (index < nodes.size()) {
+        const Node &node = nodes[index];
+        Bounds box(bounds.min + glm::vec3(node.min[0], node.min[1], node.min[2]) * invScale,
+                   bounds.min + glm::vec3(node.max[0], node.max[1], node.max[2]) * invScale);
+        float tMin = 0.f, tMax = maxT;
+        bool overlap = box.intersectRay(origin, invDirection, tMin, tMax);
+
+        if (node.data & LEAF_FLAG) {
+            if (overlap) {
+                uint32_t first = (node.data & ~LEAF_FLAG) >> 3;
+                uint32_t count = node.data & 7;
+                glm::vec3 a, b, c;
+                for (uint32_t i = first; i < first + count; i++) {
+                    getTriangle(i, a, b, c);
+                    float t = rayTriangleIntersection(origin, direction, a, b, c, maxT);
+                    if (t < 0.f) continue;
+                    best = maxT = t;
+                    normal = hitNormal(a, b, c, direction);
+                }
+            }
+            index++;
+        } else {
+            index = overlap ? index + 1 : node.data;
+        }
+    }
+    return best;
+}
+
+TriangleMeshData& TriangleMeshData::fromTriangles(const std::string &key, const std::vector<glm::vec3> &vertices, const std::vector<uint32_t> &indices) {
+    TriangleMeshData &mesh = meshes[key];
+    mesh.vertices = vertices;
+    mesh.indices = indices;
+    mesh.build();
+    return mesh;
+}
+
+TriangleMeshData& TriangleMeshData::loadMesh(const char *directory, const char *fileName, int layer) {
+    std::string key = std::string(directory) + fileName + "#" + std::to_string(layer);
+    auto found = meshes.find(key);
+    if (found != meshes.end()) return found->second;
+
+    TriangleMeshData &res = meshes[key];
+
+    Assimp::Importer importer;
+    std::string filePath = std::string(directory) + fileName;
+    const aiScene* scene = importer.ReadFile(filePath,
+        aiProcess_Triangulate |
+        aiProcess_JoinIdenticalVertices |
+        aiProcess_SortByPType);
+
+    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+        std::cerr << "Assimp error: " << importer.GetErrorString() << std::endl;
+        return res;
+    }
+
+    for (unsigned int i = layer; i < std::min(static_cast<unsigned int>(layer + 1), scene->mNumMeshes); ++i) {
+        aiMesh* mesh = scene->mMeshes[i];
+
+        for (unsigned int j = 0; j < mesh->mNumFaces; ++j) {
+            aiFace& face = mesh->mFaces[j];
+            // points and lines have nothing to collide with
+            if (face.mNumIndices != 3) continue;
+            for (unsigned int k = 0; k < 3; ++k) res.indices.push_back(face.mIndices[k]);
+        }
+
+        for (unsigned int j = 0; j < mesh->mNumVertices; ++j) {
+            aiVector3D vertex = mesh->mVertices[j];
+            res.vertices.push_back(glm::vec3(vertex.x, vertex.y, vertex.z));
+        }
+    }
+
+    res.build();
+    return res;
+}
+
+////////////  Heightfield
+
+bool HeightfieldData::cellRange(const Bounds &localBounds, int &x0, int &x1, int &z0, int &z1) const {
+    if (width < 2 || depth < 2 || !bounds.overlaps(localBounds)) return false;
+
+    glm::vec3 corner = sample(0, 0);
+    x0 = std::max(0, (int) std::floor((localBounds.min.x - corner.x) / cellSize));
+    z0 = std::max(0, (int) std::floor((localBounds.min.z - corner.z) / cellSize));
+    x1 = std::min(width - 2, (int) std::floor((localBounds.max.x - corner.x) / cellSize));
+    z1 = std::min(depth - 2, (int) std::floor((localBounds.max.z - corner.z) / cellSize));
+    return x0 <= x1 && z0 <= z1;
+}
+
+// walks the cells under the ray in order, the first cell with a hit holds the closest one
+float HeightfieldData::raycast(const glm::vec3 &origin, const glm::vec3 &direction, float maxT, glm::vec3 &normal) const {
+    if (width < 2 || depth < 2) return -1;
+
+    float tEnter = 0.f, tExit = maxT;
+    if (!bounds.intersectRay(origin, 1.f / direction, tEnter, tExit)) return -1;
+
+    glm::vec3 corner = sample(0, 0);
+    glm::vec3 entry = origin + direction * tEnter;
+    int x = std::max(0, std::min(width - 2, (int) std::floor((entry.x - corner.x) / cellSize)));
+    int z = std::max(0, std::min(depth - 2, (int) std::floor((entry.z - corner.z) / cellSize)));
+
+    int stepX = direction.x > 0.f ? 1 : -1;
+    int stepZ = direction.z > 0.f ? 1 : -1;
+    float tDeltaX = direction.x != 0.f ? cellSize / std::fabs(direction.x) : FLT_MAX;
+    float tDeltaZ = direction.z != 0.f ? cellSize / std::fabs(direction.z) : FLT_MAX;
+    float tNextX = direction.x != 0.f ? (corner.x + (x + (stepX > 0 ? 1 : 0)) * cellSize - origin.x) / direction.x : FLT_MAX;
+    float tNextZ = direction.z != 0.f ? (corner.z + (z + (stepZ > 0 ? 1 : 0)) * cellSize - origin.z) / direction.z : FLT_MAX;
+
+    while (x >= 0 && x < width - 1 && z >= 0 && z < depth - 1) {
+        glm::vec3 p00 = sample(x, z), p10 = sample(x + 1, z);
+        glm::vec3 p01 = sample(x, z + 1), p11 = sample(x + 1, z + 1);
+
+        float best = -1;
+        float t = rayTriangleIntersection(origin, direction, p00, p01, p11, maxT);
+        if (t >= 0.f) {
+            best = t;
+            normal = hitNormal(p00, p01, p11, direction);
+        }
+        t = rayTriangleIntersection(origin, direction, p00, p11, p10, maxT);
+        if (t >= 0.f && (best < 0.f || t < best)) {
+            best = t;
+            normal = hitNormal(p00, p11, p10, direction);
+        }
+        if (best >= 0.f) return best;
+
+        if (tNextX < tNextZ) {
+            if (tNextX > tExit) break;
+            x += stepX;
+            tNextX += tDeltaX;
+        } else {
+            if (tNextZ > tExit) break;
+            z += stepZ;
+            tNextZ += tDeltaZ;
+        }
+    }
+    return -1;
+}
+
+HeightfieldData& HeightfieldData::fromHeights(const std::string &key, int width, int depth, float cellSize, const std::vector<float> &heights) {
+    HeightfieldData &res = heightfields[key];
+    res.width = width;
+    res.depth = depth;
+    res.cellSize = cellSize;
+    res.heights = heights;
+
+    float low = FLT_MAX, high = -FLT_MAX;
+    for (float h : heights) {
+        low = std::min(low, h);
+        high = std::max(high, h);
+    }
+    glm::vec3 half((width - 1) * 0.5f * cellSize, 0.f, (depth - 1) * 0.5f * cellSize);
+    res.bounds = Bounds(glm::vec3(-half.x, low, -half.z), glm::vec3(half.x, high, half.z));
+    return res;
+}
+
+HeightfieldData& HeightfieldData::loadHeightmap(const char *path, float cellSize, float heightScale) {
+    auto found = heightfields.find(path);
+    if (found != heightfields.end()) return found->second;
+
+    int width, height, channels;
+    unsigned char *data = stbi_load(path, &width, &height, &channels, 1);
+    if (!data) {
+        std::cerr << "Failed to load heightmap: " << path << std::endl;
+        return heightfields[path];
+    }
+
+    std::vector<float> heights(width * height);
+    for (int i = 0; i < width * height; i++) heights[i] = data[i] / 255.f * heightScale;
+    stbi_image_free(data);
+
+    return fromHeights(path, width, height, cellSize, heights);
+}
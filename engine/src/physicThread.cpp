@@ -0,0 +1,107 @@
+#include <engine/include/physicThread.hpp>
+#include <engine/include/ecs/implementations/systems.hpp>
+
+PhysicThread& PhysicThread::getInstance() {
+    static PhysicThread instance;
+    return instance;
+}
+
+PhysicThread::~PhysicThread() {
+    if (!thread.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    kickCondition.notify_all();
+    thread.join();
+}
+
+void PhysicThread::kick(std::function<void()> newJob) {
+    waitIdle();
+    if (!thread.joinable()) thread = std::thread(&PhysicThread::threadLoop, this);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = std::move(newJob);
+        busy = true;
+    }
+    kickCondition.notify_all();
+}
+
+void PhysicThread::waitIdle() {
+    std::unique_lock<std::mutex> lock(mutex);
+    doneCondition.wait(lock, [&] { return !busy; });
+}
+
+void PhysicThread::wait() {
+    waitIdle();
+    poseSlots.clear();
+    poses.clear();
+}
+
+bool PhysicThread::isBusy() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return busy;
+}
+
+void PhysicThread::threadLoop() {
+    while (true) {
+        std::function<void()> current;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            kickCondition.wait(lock, [&] { return stopping || busy; });
+            if (stopping) return;
+            current = std::move(job);
+        }
+        current();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            busy = false;
+        }
+        doneCondition.notify_all();
+    }
+}
+
+void PhysicThread::publishPoses(const std::vector<Transform*> &transforms) {
+    poseSlots.clear();
+    poses.resize(transforms.size());
+    for (size_t i = 0; i < transforms.size(); i++) {
+        poseSlots[transforms[i]] = i;
+        poses[i] = transforms[i]->getModelMatrix();
+    }
+}
+
+bool PhysicThread::getPose(const Transform *transform, glm::mat4 &matrix) const {
+    if (poses.empty()) return false;
+    auto it = poseSlots.find(transform);
+    if (it == poseSlots.end()) return false;
+    matrix = poses[it->second];
+    return true;
+}
+
+bool PhysicThread::push(const PhysicCommand &command) {
+    return commands.push(command);
+}
+
+void PhysicThread::applyCommands(float deltaTime) {
+    PhysicCommand command;
+    while (commands.pop(command)) {
+        // the entity may have been destroyed since the command was sent
+        if (!ecs.HasComponent<RigidBody>(command.entity)) continue;
+        RigidBody &rigidBody = ecs.GetComponent<RigidBody>(command.entity);
+
+        switch (command.type) {
+            case PhysicCommand::ADD_FORCE:
+                rigidBody.addLinearImpulse(command.value * rigidBody.invMass * deltaTime);
+                break;
+            case PhysicCommand::ADD_IMPULSE:
+                rigidBody.addLinearImpulse(command.value);
+                break;
+            case PhysicCommand::SET_VELOCITY:
+                rigidBody.velocity = command.value;
+                break;
+            case PhysicCommand::SET_POSITION:
+                rigidBody.teleport(ecs.GetComponent<Transform>(command.entity), command.value);
+                break;
+        }
+    }
+}
@@ -6,11 +6,16 @@
 #include <engine/include/rendering.hpp>
 #include <common/shader.hpp>
 #include <engine/include/rendering.hpp>
+#include <algorithm>
+#include <cassert>
+#include <cstring>
 #include <fstream>
 
 std::map<std::string, Texture> Texture::textures;
 std::vector<std::unique_ptr<Program>> Program::programs;
 int Texture::activationInt = 0;
+CameraUniforms::Block CameraUniforms::block = {glm::mat4(1), glm::mat4(1), glm::vec4(0, 0, 0, 1), 0.f, {}};
+GLuint CameraUniforms::buffer = 0;
 
 int Texture::getAvailableActivationInt(){
     return activationInt ++;
@@ -150,24 +155,160 @@ Texture& Texture::loadTexture(const char * path){
     return texture;
 }
 
-void Texture::activate(GLuint textureLocation){
+void Texture::activate(Program &program, UniformHandle sampler){
     glBindTextureUnit(activationInt, id);
-    glUniform1i(textureLocation, activationInt);
+    program.set(sampler, activationInt);
     activationInt ++;
 }
 
+void CameraUniforms::set(const glm::mat4 &view, const glm::mat4 &projection){
+    block.v = view;
+    block.p = projection;
+    block.cameraPosition = glm::vec4(glm::vec3(glm::inverse(view)[3]), 1.f);
+
+    if(!buffer){
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), nullptr, GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_UNIFORM_BUFFER, BINDING, buffer);
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Block), &block);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void CameraUniforms::setTime(float time){
+    block.time = time;
+}
+
+void CameraUniforms::clear(){
+    if(buffer) glDeleteBuffers(1, &buffer);
+    buffer = 0;
+}
+
 Program::Program(const char *vertexPath, const char *fragmentPath){
     programID = LoadShaders( vertexPath, fragmentPath );
     glUseProgram(programID);
 
-    modelLocation = glGetUniformLocation(programID, "model");
-    vLocation = glGetUniformLocation(programID, "v");
-    pLocation = glGetUniformLocation(programID, "p");
+    reflect();
+    modelUniform = getUniform("model");
+
+    // no layout(binding) before GLSL 420
+    GLuint cameraBlock = getUniformBlock("CameraBlock");
+    if(cameraBlock != GL_INVALID_INDEX){
+        glUniformBlockBinding(programID, cameraBlock, CameraUniforms::BINDING);
+    }
+}
+
+static bool isSampler(GLenum type){
+    switch(type){
+        case GL_SAMPLER_1D:
+        case GL_SAMPLER_2D:
+        case GL_SAMPLER_3D:
+        case GL_SAMPLER_CUBE:
+        case GL_SAMPLER_2D_SHADOW:
+        case GL_SAMPLER_2D_ARRAY:
+        case GL_SAMPLER_BUFFER:
+        case GL_INT_SAMPLER_2D:
+        case GL_INT_SAMPLER_BUFFER:
+        case GL_UNSIGNED_INT_SAMPLER_2D:
+        case GL_UNSIGNED_INT_SAMPLER_BUFFER:
+            return true;
+        default:
+            return false;
+    }
+}
+
+void Program::reflect(){
+    uniforms.clear();
+    uniformHandles.clear();
+    uniformBlocks.clear();
+
+    GLint count = 0, maxLength = 0;
+    glGetProgramiv(programID, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(programID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::vector<char> name(std::max(maxLength, 1));
+    for(GLuint i = 0; i < (GLuint) count; i++){
+        GLint size, blockIndex;
+        GLenum type;
+        GLsizei length;
+        glGetActiveUniform(programID, i, name.size(), &length, &size, &type, name.data());
+        // block members have no location, they are set through their buffer
+        glGetActiveUniformsiv(programID, 1, &i, GL_UNIFORM_BLOCK_INDEX, &blockIndex);
+        if(blockIndex != -1) continue;
+
+        // arrays are reported as "name[0]" with their size
+        std::string baseName(name.data(), length);
+        bool array = baseName.size() > 3 && baseName.compare(baseName.size() - 3, 3, "[0]") == 0;
+        if(array) baseName.resize(baseName.size() - 3);
+
+        for(GLint element = 0; element < size; element++){
+            std::string elementName = array ? baseName + "[" + std::to_string(element) + "]" : baseName;
+            Uniform uniform;
+            uniform.location = glGetUniformLocation(programID, elementName.c_str());
+            uniform.type = type;
+            uniform.sampler = isSampler(type);
+            uniformHandles[elementName] = uniforms.size();
+            if(array && element == 0) uniformHandles[baseName] = uniforms.size();
+            uniforms.push_back(uniform);
+        }
+    }
+
+    glGetProgramiv(programID, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+    glGetProgramiv(programID, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxLength);
+    name.resize(std::max(maxLength, 1));
+    for(GLuint i = 0; i < (GLuint) count; i++){
+        GLsizei length;
+        glGetActiveUniformBlockName(programID, i, name.size(), &length, name.data());
+        uniformBlocks[std::string(name.data(), length)] = i;
+    }
+}
+
+UniformHandle Program::getUniform(const std::string &name) const {
+    auto it = uniformHandles.find(name);
+    return it == uniformHandles.end() ? -1 : it->second;
+}
+
+std::vector<UniformHandle> Program::getUniformArray(const std::string &name) const {
+    std::vector<UniformHandle> res;
+    UniformHandle handle;
+    while((handle = getUniform(name + "[" + std::to_string(res.size()) + "]")) >= 0) res.push_back(handle);
+    return res;
+}
+
+GLuint Program::getUniformBlock(const std::string &name) const {
+    auto it = uniformBlocks.find(name);
+    return it == uniformBlocks.end() ? GL_INVALID_INDEX : it->second;
+}
 
-    glm::mat4 p = Camera::getInstance().getP();
-    updateProjectionMatrix(p);
-    glm::mat4 camProj = Camera::getInstance().getP();
-    updateProjectionMatrix(camProj);
+bool Program::changed(UniformHandle handle, const void *value, size_t size){
+    if(handle < 0) return false;
+    Uniform &uniform = uniforms[handle];
+    if(uniform.sent && std::memcmp(uniform.value, value, size) == 0) return false;
+    std::memcpy(uniform.value, value, size);
+    uniform.sent = true;
+    return true;
+}
+
+void Program::set(UniformHandle handle, int value){
+    assert(handle < 0 || uniforms[handle].type == GL_INT || uniforms[handle].type == GL_BOOL || uniforms[handle].sampler);
+    if(changed(handle, &value, sizeof(value))) glUniform1i(uniforms[handle].location, value);
+}
+void Program::set(UniformHandle handle, float value){
+    assert(handle < 0 || uniforms[handle].type == GL_FLOAT);
+    if(changed(handle, &value, sizeof(value))) glUniform1f(uniforms[handle].location, value);
+}
+void Program::set(UniformHandle handle, const glm::vec3 &value){
+    assert(handle < 0 || uniforms[handle].type == GL_FLOAT_VEC3);
+    if(changed(handle, &value, sizeof(value))) glUniform3fv(uniforms[handle].location, 1, &value[0]);
+}
+void Program::set(UniformHandle handle, const glm::vec4 &value){
+    assert(handle < 0 || uniforms[handle].type == GL_FLOAT_VEC4);
+    if(changed(handle, &value, sizeof(value))) glUniform4fv(uniforms[handle].location, 1, &value[0]);
+}
+void Program::set(UniformHandle handle, const glm::mat4 &value){
+    assert(handle < 0 || uniforms[handle].type == GL_FLOAT_MAT4);
+    if(changed(handle, &value, sizeof(value))) glUniformMatrix4fv(uniforms[handle].location, 1, GL_FALSE, &value[0][0]);
 }
 
 void Program::clear(){
@@ -183,16 +324,11 @@ void Program::destroyPrograms(){
     }
 
     programs.clear();
+    CameraUniforms::clear();
 }
 
-void Program::updateViewMatrix(glm::mat4 &v){
-    glUniformMatrix4fv(vLocation, 1, GL_FALSE, &v[0][0]);
-}
-void Program::updateProjectionMatrix(glm::mat4 &p){
-    glUniformMatrix4fv(pLocation, 1, GL_FALSE, &p[0][0]);
-}
-void Program::updateModelMatrix(glm::mat4 model){
-    glUniformMatrix4fv(modelLocation, 1, GL_FALSE, &model[0][0]);
+void Program::updateModelMatrix(const glm::mat4 &model){
+    set(modelUniform, model);
 }
 
 void Program::beforeRender(){}
@@ -201,35 +337,30 @@ void Program::afterRender(){}
 void Program::initTexture(char *path, char *uniformName){
     Texture &texture = Texture::loadTexture(path);
 
-    GLuint textureLocation = glGetUniformLocation(programID, uniformName);
-
-    programTextures.emplace(textureLocation, &texture);
+    programTextures.emplace(getUniform(uniformName), &texture);
 }
 
 
 void Program::renderTextures(){
     glUseProgram(programID);
-    for (auto& [textureLocation, texture] : programTextures) {
+    for (auto& [sampler, texture] : programTextures) {
         if (texture->id == 0){
             std::cerr << "ID de texture invalide\n";
             continue;
         }
 
-        texture->activate(textureLocation);
+        texture->activate(*this, sampler);
     }
 }
 
 void PBR::updateLightCount(int count){
-    GLuint lightCountLocation = glGetUniformLocation(programID, "lightCount");
-    glUniform1i(lightCountLocation, count);
+    set(lightCountUniform, count);
 }
 void PBR::updateLightPosition(int lightIndex, glm::vec3 position){
-    GLuint lightLocation = glGetUniformLocation(programID, ("lightPositions[" + std::to_string(lightIndex) + "]").c_str());
-    glUniform3f(lightLocation, position[0], position[1], position[2]);
+    if(lightIndex >= 0 && (size_t)lightIndex < lightPositionUniforms.size()) set(lightPositionUniforms[lightIndex], position);
 }
 void PBR::updateLightColor(int lightIndex, glm::vec3 color){
-    GLuint lightLocation = glGetUniformLocation(programID, ("lightColors[" + std::to_string(lightIndex) + "]").c_str());
-    glUniform3f(lightLocation, color[0], color[1], color[2]);
+    if(lightIndex >= 0 && (size_t)lightIndex < lightColorUniforms.size()) set(lightColorUniforms[lightIndex], color);
 }
 
 void Skybox::beforeRender(){
@@ -238,15 +369,16 @@ void Skybox::beforeRender(){
     int current = Texture::getAvailableActivationInt();
     glActiveTexture(GL_TEXTURE0 + current);
     glBindTexture(GL_TEXTURE_CUBE_MAP, cubemap.textureID);
-    GLuint loc = glGetUniformLocation(programID, "skybox");
-    glUniform1i(loc, current);
+    set(skyboxUniform, current);
 }
 
 void Skybox::afterRender(){
     glDepthMask(GL_TRUE);
 }
 
-Skybox::Skybox(Cubemap sky):Program("shaders/skybox/vertex.glsl", "shaders/skybox/fragment.glsl"), cubemap(sky){}
+Skybox::Skybox(Cubemap sky):Program("shaders/skybox/vertex.glsl", "shaders/skybox/fragment.glsl"), cubemap(sky){
+    skyboxUniform = getUniform("skybox");
+}
 
 IrradianceShader::IrradianceShader():Program("shaders/skybox/vertex.glsl", "shaders/skybox/irradiance_convolution.glsl"){}
 
@@ -254,14 +386,15 @@ PrefilterShader::PrefilterShader():Program("shaders/skybox/vertex.glsl", "shader
 
 BrdfShader::BrdfShader():Program("shaders/skybox/BRDF_vs.glsl", "shaders/skybox/BRDF_fs.glsl"){}
 
-CubemapProg::CubemapProg(): Program("shaders/cubemap/vertex.glsl", "shaders/cubemap/fragment.glsl"){}
+CubemapProg::CubemapProg(): Program("shaders/cubemap/vertex.glsl", "shaders/cubemap/fragment.glsl"){
+    skyboxUniform = getUniform("skybox");
+}
 
 void CubemapProg::beforeRender(){
     int current = Texture::getAvailableActivationInt();
     glActiveTexture(GL_TEXTURE0 + current);
     glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-    GLuint loc = glGetUniformLocation(programID, "skybox");
-    glUniform1i(loc, current);
+    set(skyboxUniform, current);
 }
 
 Cubemap::Cubemap(int resolution){
@@ -334,70 +467,99 @@ void Cubemap::clear(){
 void Program::updateGUI(){}
 
 PBR::PBR(): Program("shaders/pbr/vertex_shader.glsl", "shaders/pbr/fragment_shader.glsl"){
-    albedoLocation = glGetUniformLocation(programID, "albedoVal");
-    metallicLocation = glGetUniformLocation(programID, "metallicVal");
-    roughnessLocation = glGetUniformLocation(programID, "roughnessVal");
-    aoLocation = glGetUniformLocation(programID, "aoVal");
-
-    hasTextureLocation = glGetUniformLocation(programID, "hasTexture");
-
-    albedoTexLocation = glGetUniformLocation(programID, "albedoMap");
-    metallicTexLocation = glGetUniformLocation(programID, "metallicMap");
-    aoTexLocation = glGetUniformLocation(programID, "aoMap");
-    normalTexLocation = glGetUniformLocation(programID, "normalMap");
-    roughnessTexLocation = glGetUniformLocation(programID, "roughnessMap");
-
-    indensiteScaleLightLocation = glGetUniformLocation(programID,"indensiteScaleLight");
-
-    hasAlbedoMapLocation = glGetUniformLocation(programID, "hasAlbedoMap");
-    hasNormalMapLocation = glGetUniformLocation(programID, "hasNormalMap");
-    hasMetallicMapLocation = glGetUniformLocation(programID, "hasMetallicMap");
-    hasRoughnessMapLocation = glGetUniformLocation(programID, "hasRoughnessMap");
-    hasAoMapLocation = glGetUniformLocation(programID, "hasAoMap");
+    albedoUniform = getUniform("albedoVal");
+    metallicUniform = getUniform("metallicVal");
+    roughnessUniform = getUniform("roughnessVal");
+    aoUniform = getUniform("aoVal");
+
+    hasTextureUniform = getUniform("hasTexture");
+
+    albedoTexUniform = getUniform("albedoMap");
+    metallicTexUniform = getUniform("metallicMap");
+    aoTexUniform = getUniform("aoMap");
+    normalTexUniform = getUniform("normalMap");
+    roughnessTexUniform = getUniform("roughnessMap");
+
+    indensiteScaleLightUniform = getUniform("indensiteScaleLight");
+
+    hasAlbedoMapUniform = getUniform("hasAlbedoMap");
+    hasNormalMapUniform = getUniform("hasNormalMap");
+    hasMetallicMapUniform = getUniform("hasMetallicMap");
+    hasRoughnessMapUniform = getUniform("hasRoughnessMap");
+    hasAoMapUniform = getUniform("hasAoMap");
+
+    instancedUniform = getUniform("instanced");
+    lightCountUniform = getUniform("lightCount");
+    lightPositionUniforms = getUniformArray("lightPositions");
+    lightColorUniforms = getUniformArray("lightColors");
+    bonePaletteUniform = getUniform("bonePalette");
+    boneOffsetUniform = getUniform("boneOffset");
+
+    irradianceMapUniform = getUniform("irradianceMap");
+    prefilterMapUniform = getUniform("prefilterMap");
+    brdfLUTMapUniform = getUniform("brdfLUTMap");
 }
 
 void PBR::updateMaterial(Material &material){
-    glUniform1f(metallicLocation, material.metallic);
-    glUniform1f(roughnessLocation, material.roughness);
-    glUniform1f(aoLocation, material.ao);
-    glUniform3f(albedoLocation, material.albedo[0], material.albedo[1], material.albedo[2]);
+    set(metallicUniform, material.metallic);
+    set(roughnessUniform, material.roughness);
+    set(aoUniform, material.ao);
+    set(albedoUniform, material.albedo);
     
     if (material.albedoTex->visible){
-        material.albedoTex->activate(albedoTexLocation);
-        glUniform1i(hasAlbedoMapLocation, 1);
+        material.albedoTex->activate(*this, albedoTexUniform);
+        set(hasAlbedoMapUniform, 1);
     } else {
-        glUniform1i(hasAlbedoMapLocation, 0);
+        set(hasAlbedoMapUniform, 0);
     }
     
     if (material.metallicTex->visible){
-        material.metallicTex->activate(metallicTexLocation);
-        glUniform1i(hasMetallicMapLocation, 1);
+        material.metallicTex->activate(*this, metallicTexUniform);
+        set(hasMetallicMapUniform, 1);
     } else {
-        glUniform1i(hasMetallicMapLocation, 0);
+        set(hasMetallicMapUniform, 0);
     }
     
     if (material.aoTex->visible){
-        material.aoTex->activate(aoTexLocation);
-        glUniform1i(hasAoMapLocation, 1);
+        material.aoTex->activate(*this, aoTexUniform);
+        set(hasAoMapUniform, 1);
     } else {
-        glUniform1i(hasAoMapLocation, 0);
+        set(hasAoMapUniform, 0);
     }
     
     if (material.normalTex->visible){
-        material.normalTex->activate(normalTexLocation);
-        glUniform1i(hasNormalMapLocation, 1);
+        material.normalTex->activate(*this, normalTexUniform);
+        set(hasNormalMapUniform, 1);
     } else {
-        glUniform1i(hasNormalMapLocation, 0);
+        set(hasNormalMapUniform, 0);
     }
     
     if (material.roughnessTex->visible){
-        material.roughnessTex->activate(roughnessTexLocation);
-        glUniform1i(hasRoughnessMapLocation, 1);
+        material.roughnessTex->activate(*this, roughnessTexUniform);
+        set(hasRoughnessMapUniform, 1);
     } else {
-        glUniform1i(hasRoughnessMapLocation, 0);
+        set(hasRoughnessMapUniform, 0);
     }
 }
 
+void PBR::setInstanced(bool value){
+    set(instancedUniform, (int) value);
+}
+
+void PBR::updateEnvironmentMaps(int irradianceUnit, int prefilterUnit, int brdfLUTUnit){
+    set(irradianceMapUniform, irradianceUnit);
+    set(prefilterMapUniform, prefilterUnit);
+    set(brdfLUTMapUniform, brdfLUTUnit);
+}
+
+void PBR::updateBonePalette(int unit){
+    set(bonePaletteUniform, unit);
+}
+
+void PBR::updateBoneOffset(int offset){
+    set(boneOffsetUniform, offset);
+}
+
 void PBR::updateGUI(){}
 
 
@@ -1,53 +1,302 @@
 #include <engine/include/spatial.hpp>
 #include <engine/include/geometryHelper.hpp>
+#include <engine/include/ecs/implementations/systems.hpp>
+#include <engine/include/jobSystem.hpp>
+#include <engine/include/simd.hpp>
 
 
-void SpatialNode::AddChild(std::unique_ptr<SpatialNode> child) {
-    child->parent_ = this;  // On défini le parent de l'enfant avant de l'ajouter
-    children_.emplace_back(std::move(child));  // Ajoute l'enfant en prenant la propriété de l'objet
+SceneGraph::SceneGraph() {
+    clear();
 }
 
-void SpatialNode::RemoveChild(SpatialNode* component) {
-    for (auto it = children_.begin(); it != children_.end(); ++it) {
-        if (it->get() == component) {  // Vérifie si l'enfant correspond
-            it->get()->SetParent(nullptr);  // Déconnecte le parent
-            children_.erase(it);  // Enlève l'enfant du vecteur
-            break;
+void SceneGraph::clear() {
+    levels.assign(1, Level());
+    slots.assign(MAX_ENTITIES + 1, Slot());
+    parentOf.assign(MAX_ENTITIES + 1, NO_ENTITY);
+    firstChild.assign(MAX_ENTITIES + 1, NO_ENTITY);
+    nextSibling.assign(MAX_ENTITIES + 1, NO_ENTITY);
+    previousSibling.assign(MAX_ENTITIES + 1, NO_ENTITY);
+    rootEntity = NO_ENTITY;
+
+    insertNode(ROOT, 0, &defaultRoot);
+    nodeCount = 0;
+}
+
+void SceneGraph::setRoot(Entity entity) {
+    assert(!contains(entity) && "The root entity can't be a node of the graph.");
+    rootEntity = entity;
+    levels[0].transforms[0] = &ecs.GetComponent<Transform>(entity);
+    levels[0].moved[0] = 1;
+}
+
+Entity SceneGraph::resolve(Entity entity) const {
+    return entity == rootEntity ? ROOT : entity;
+}
+
+bool SceneGraph::contains(Entity entity) const {
+    entity = resolve(entity);
+    return entity < slots.size() && slots[entity].level != NO_SLOT;
+}
+
+Entity SceneGraph::getParent(Entity entity) const {
+    Entity parent = parentOf[resolve(entity)];
+    return parent == ROOT && rootEntity != NO_ENTITY ? rootEntity : parent;
+}
+
+void SceneGraph::add(Entity entity, Entity parent) {
+    parent = resolve(parent);
+    assert(entity < MAX_ENTITIES && !contains(entity) && "Entity already in the scene graph.");
+    assert(contains(parent) && "Parent must be added before its children.");
+
+    link(entity, parent);
+    insertNode(entity, slots[parent].level + 1, &ecs.GetComponent<Transform>(entity));
+}
+
+void SceneGraph::remove(Entity entity) {
+    entity = resolve(entity);
+    assert(entity != ROOT && contains(entity));
+
+    std::vector<Entity> subtree;
+    collectSubtree(entity, subtree);
+    unlink(entity);
+    for (Entity node : subtree) {
+        eraseNode(node);
+        parentOf[node] = firstChild[node] = nextSibling[node] = previousSibling[node] = NO_ENTITY;
+    }
+    while (levels.size() > 1 && levels.back().entities.empty()) levels.pop_back();
+}
+
+void SceneGraph::setParent(Entity entity, Entity parent) {
+    entity = resolve(entity);
+    parent = resolve(parent);
+    assert(entity != ROOT && contains(entity) && contains(parent));
+    for (Entity ancestor = parent; ancestor != ROOT; ancestor = parentOf[ancestor]) {
+        assert(ancestor != entity && "A node can't be moved under its own subtree.");
+    }
+
+    unlink(entity);
+    link(entity, parent);
+
+    uint32_t level = slots[parent].level + 1;
+    if (level == slots[entity].level) {
+        levels[level].parents[slots[entity].index] = slots[parent].index;
+        levels[level].moved[slots[entity].index] = 1;
+        return;
+    }
+
+    // the whole subtree changes depth, parents are moved before their children
+    std::vector<Entity> subtree;
+    collectSubtree(entity, subtree);
+    int shift = (int) level - (int) slots[entity].level;
+    for (Entity node : subtree) {
+        Slot slot = slots[node];
+        Transform *transform = levels[slot.level].transforms[slot.index];
+        eraseNode(node);
+        insertNode(node, slot.level + shift, transform);
+    }
+    while (levels.size() > 1 && levels.back().entities.empty()) levels.pop_back();
+}
+
+void SceneGraph::link(Entity entity, Entity parent) {
+    parentOf[entity] = parent;
+    previousSibling[entity] = NO_ENTITY;
+    nextSibling[entity] = firstChild[parent];
+    if (firstChild[parent] != NO_ENTITY) previousSibling[firstChild[parent]] = entity;
+    firstChild[parent] = entity;
+}
+
+void SceneGraph::unlink(Entity entity) {
+    Entity parent = parentOf[entity];
+    if (previousSibling[entity] != NO_ENTITY) nextSibling[previousSibling[entity]] = nextSibling[entity];
+    else firstChild[parent] = nextSibling[entity];
+    if (nextSibling[entity] != NO_ENTITY) previousSibling[nextSibling[entity]] = previousSibling[entity];
+    parentOf[entity] = nextSibling[entity] = previousSibling[entity] = NO_ENTITY;
+}
+
+void SceneGraph::insertNode(Entity entity, uint32_t level, Transform *transform) {
+    if (levels.size() <= level) levels.resize(level + 1);
+    Level &nodes = levels[level];
+    slots[entity] = {level, (uint32_t) nodes.entities.size()};
+    nodes.entities.push_back(entity);
+    nodes.parents.push_back(entity == ROOT ? 0 : slots[parentOf[entity]].index);
+    nodes.transforms.push_back(transform);
+    nodes.moved.push_back(1);
+    nodes.marks.push_back(0);
+    nodeCount++;
+}
+
+// the last node of the level takes the free slot, its children are told
+void SceneGraph::eraseNode(Entity entity) {
+    Slot slot = slots[entity];
+    Level &nodes = levels[slot.level];
+    uint32_t last = nodes.entities.size() - 1;
+    if (slot.index != last) {
+        Entity moved = nodes.entities[last];
+        nodes.entities[slot.index] = moved;
+        nodes.parents[slot.index] = nodes.parents[last];
+        nodes.transforms[slot.index] = nodes.transforms[last];
+        nodes.moved[slot.index] = nodes.moved[last];
+        nodes.marks[slot.index] = nodes.marks[last];
+        slots[moved].index = slot.index;
+        // while a subtree changes depth the children of a moved node may not be in the next level yet,
+        // they get their parent slot when they are inserted again
+        for (Entity child = firstChild[moved]; child != NO_ENTITY; child = nextSibling[child]) {
+            if (slots[child].level == slot.level + 1) levels[slot.level + 1].parents[slots[child].index] = slot.index;
         }
     }
+    nodes.entities.pop_back();
+    nodes.parents.pop_back();
+    nodes.transforms.pop_back();
+    nodes.moved.pop_back();
+    nodes.marks.pop_back();
+    slots[entity] = Slot();
+    nodeCount--;
 }
 
-void SpatialNode::destroy() {
-    children_.clear(); 
+void SceneGraph::collectSubtree(Entity entity, std::vector<Entity> &out) const {
+    out.push_back(entity);
+    for (size_t i = out.size() - 1; i < out.size(); i++) {
+        for (Entity child = firstChild[out[i]]; child != NO_ENTITY; child = nextSibling[child]) out.push_back(child);
+    }
+}
 
-    if (parent_ != nullptr) {
-        parent_->RemoveChild(this);
-        parent_ = nullptr;
+// removing a Transform moves the last one of the ecs array into the hole, every cached pointer is fetched again
+void SceneGraph::refreshTransforms() {
+    size_t moves = ecs.GetComponentMoveCount<Transform>();
+    if (moves == transformMoves) return;
+    transformMoves = moves;
+    for (Level &nodes : levels) {
+        for (size_t i = 0; i < nodes.entities.size(); i++) {
+            Entity entity = nodes.entities[i];
+            if (entity != ROOT) nodes.transforms[i] = &ecs.GetComponent<Transform>(entity);
+        }
     }
+    if (rootEntity != NO_ENTITY) levels[0].transforms[0] = &ecs.GetComponent<Transform>(rootEntity);
+}
 
+void SceneGraph::updateTransforms() {
+    propagate(false);
 }
 
-void SpatialNode::updateSelfAndChildTransform() {
-    if (transform->isDirty()) {
-        forceUpdateSelfAndChild();
-        return;
+void SceneGraph::forceUpdateTransforms() {
+    propagate(true);
+}
+
+// a node is recomputed if its transform is dirty, if it moved in the graph or if its parent was recomputed;
+// the others only cost the flag checks. Nodes of a level only read the previous level, so a level is split
+// across the workers, small levels stay on the calling thread.
+void SceneGraph::propagate(bool force) {
+    refreshTransforms();
+    Level &rootLevel = levels[0];
+    bool rootUpdate = force || rootLevel.moved[0] || rootLevel.transforms[0]->isDirty();
+    if (rootUpdate) rootLevel.transforms[0]->computeModelMatrix();
+    rootLevel.marks[0] = rootUpdate;
+    rootLevel.moved[0] = 0;
+
+    JobSystem &jobs = JobSystem::getInstance();
+    for (size_t depth = 1; depth < levels.size(); depth++) {
+        size_t count = levels[depth].entities.size();
+        // deep chains have many tiny levels, no job for those
+        if (count <= minNodesPerChunk) {
+            propagateLevel(depth, 0, count, force);
+            continue;
+        }
+        jobs.parallelFor(count, minNodesPerChunk, [this, depth, force](size_t begin, size_t end, unsigned){
+            propagateLevel(depth, begin, end, force);
+        });
     }
+}
+
+void SceneGraph::propagateLevel(size_t depth, size_t begin, size_t end, bool force) {
+    const Level &parentLevel = levels[depth - 1];
+    Level &nodes = levels[depth];
+    Transform *batch[simd::WIDTH];
+    const Transform *batchParents[simd::WIDTH];
+    int batchSize = 0;
+    for (size_t i = begin; i < end; i++) {
+        uint32_t parent = nodes.parents[i];
+        bool update = force || parentLevel.marks[parent] || nodes.moved[i] || nodes.transforms[i]->isDirty();
+        nodes.marks[i] = update;
+        nodes.moved[i] = 0;
+        if (!update) continue;
 
-    for (auto&& child : children_) {
-        child->updateSelfAndChildTransform();
+        batch[batchSize] = nodes.transforms[i];
+        batchParents[batchSize] = parentLevel.transforms[parent];
+        if (++batchSize == simd::WIDTH) {
+            composeBatch(batch, batchParents, batchSize);
+            batchSize = 0;
+        }
     }
+    if (batchSize > 0) composeBatch(batch, batchParents, batchSize);
 }
 
-void SpatialNode::forceUpdateSelfAndChild() {
-    if (parent_) {
-        transform->computeModelMatrix(parent_->transform->getModelMatrix());
+// world = parent * T * R * S for simd::WIDTH transforms at once. The inputs are gathered in SoA lanes and
+// the matrices are handled as 3x4 affine ones, the last row of every model matrix being (0, 0, 0, 1).
+void SceneGraph::composeBatch(Transform *const *transforms, const Transform *const *parents, int count) {
+    using namespace simd;
+    enum { PX, PY, PZ, QX, QY, QZ, QW, SX, SY, SZ, PARENT, INPUTS = PARENT + 12 };
+    alignas(32) float in[INPUTS][WIDTH];
+    alignas(32) float out[12][WIDTH];
+
+    for (int lane = 0; lane < WIDTH; lane++) {
+        // unused lanes repeat the first transform
+        const Transform &t = *transforms[lane < count ? lane : 0];
+        const glm::mat4 &parent = parents[lane < count ? lane : 0]->modelMatrix;
+        in[PX][lane] = t.pos.x; in[PY][lane] = t.pos.y; in[PZ][lane] = t.pos.z;
+        in[QX][lane] = t.rotationQuat.x; in[QY][lane] = t.rotationQuat.y; in[QZ][lane] = t.rotationQuat.z; in[QW][lane] = t.rotationQuat.w;
+        in[SX][lane] = t.scale.x; in[SY][lane] = t.scale.y; in[SZ][lane] = t.scale.z;
+        for (int column = 0; column < 4; column++) {
+            for (int row = 0; row < 3; row++) in[PARENT + column * 3 + row][lane] = parent[column][row];
+        }
+    }
+
+    Float qx = load(in[QX]), qy = load(in[QY]), qz = load(in[QZ]), qw = load(in[QW]);
+    Float sx = load(in[SX]), sy = load(in[SY]), sz = load(in[SZ]);
+    Float xx = qx * qx, yy = qy * qy, zz = qz * qz;
+    Float xy = qx * qy, xz = qx * qz, yz = qy * qz;
+    Float wx = qw * qx, wy = qw * qy, wz = qw * qz;
+    Float one(1.f), two(2.f);
+
+    // local columns, same layout as glm::mat3_cast
+    Float local[4][3] = {
+        {(one - two * (yy + zz)) * sx, two * (xy + wz) * sx, two * (xz - wy) * sx},
+        {two * (xy - wz) * sy, (one - two * (xx + zz)) * sy, two * (yz + wx) * sy},
+        {two * (xz + wy) * sz, two * (yz - wx) * sz, (one - two * (xx + yy)) * sz},
+        {load(in[PX]), load(in[PY]), load(in[PZ])}
+    };
+
+    Float parent[4][3];
+    for (int column = 0; column < 4; column++) {
+        for (int row = 0; row < 3; row++) parent[column][row] = load(in[PARENT + column * 3 + row]);
     }
-    else {
-        transform->computeModelMatrix();
+
+    for (int column = 0; column < 4; column++) {
+        for (int row = 0; row < 3; row++) {
+            Float value = parent[0][row] * local[column][0] + parent[1][row] * local[column][1] + parent[2][row] * local[column][2];
+            if (column == 3) value = value + parent[3][row];
+            store(out[column * 3 + row], value);
+        }
     }
 
-    for (auto&& child : children_) {
-        child->forceUpdateSelfAndChild();
+    for (int lane = 0; lane < count; lane++) {
+        Transform &t = *transforms[lane];
+        for (int column = 0; column < 4; column++) {
+            t.modelMatrix[column] = glm::vec4(out[column * 3][lane], out[column * 3 + 1][lane], out[column * 3 + 2][lane], column == 3 ? 1.f : 0.f);
+        }
+        t.dirty = false;
+        t.version++;
+    }
+}
+
+void SceneGraph::collectSubtrees(const std::unordered_set<const Transform*> &roots, std::vector<Transform*> &out) {
+    refreshTransforms();
+    for (size_t depth = 0; depth < levels.size(); depth++) {
+        Level &nodes = levels[depth];
+        for (size_t i = 0; i < nodes.entities.size(); i++) {
+            bool collected = roots.count(nodes.transforms[i]) || (depth > 0 && levels[depth - 1].marks[nodes.parents[i]]);
+            nodes.marks[i] = collected;
+            if (collected) out.push_back(nodes.transforms[i]);
+        }
     }
 }
 
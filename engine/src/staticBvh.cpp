@@ -0,0 +1,129 @@
+#include <engine/include/staticBvh.hpp>
+
+#include <algorithm>
+#include <cfloat>
+
+void StaticBvh::clear() {
+    nodes.clear();
+    leafData.clear();
+    for (auto *array : {&minX, &minY, &minZ, &maxX, &maxY, &maxZ}) array->clear();
+}
+
+void StaticBvh::build(const std::vector<Bounds> &bounds, const std::vector<uint32_t> &userData) {
+    clear();
+    if (bounds.empty()) return;
+
+    const uint32_t primitiveCount = bounds.size();
+    std::vector<uint32_t> order(primitiveCount);
+    std::vector<glm::vec3> centers(primitiveCount);
+    for (uint32_t i = 0; i < primitiveCount; i++) {
+        order[i] = i;
+        centers[i] = bounds[i].center();
+    }
+
+    nodes.reserve(2 * primitiveCount);
+    nodes.push_back({glm::vec3(0), 0, glm::vec3(0), primitiveCount});
+
+    struct BuildTask { uint32_t node; int depth; };
+    std::vector<BuildTask> tasks = {{0, 0}};
+
+    while (!tasks.empty()) {
+        BuildTask task = tasks.back();
+        tasks.pop_back();
+        // node may be reallocated by the push_back below
+        const uint32_t first = nodes[task.node].first;
+        const uint32_t count = nodes[task.node].count;
+
+        Bounds nodeBounds(glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX));
+        Bounds centerBounds = nodeBounds;
+        for (uint32_t i = first; i < first + count; i++) {
+            nodeBounds = nodeBounds.merged(bounds[order[i]]);
+            centerBounds = centerBounds.merged(Bounds(centers[order[i]], centers[order[i]]));
+        }
+        nodes[task.node].min = nodeBounds.min;
+        nodes[task.node].max = nodeBounds.max;
+
+        // the traversal stack holds at most one entry per level
+        if (count <= (uint32_t) MAX_LEAF_SIZE || task.depth >= STACK_SIZE - 2) continue;
+
+        // binned SAH along each axis
+        float bestCost = nodeBounds.surfaceArea() * count;
+        int bestAxis = -1, bestSplit = 0;
+        for (int axis = 0; axis < 3; axis++) {
+            float extent = centerBounds.max[axis] - centerBounds.min[axis];
+            if (extent <= 0.f) continue;
+            float scale = BIN_COUNT / extent;
+
+            Bounds binBounds[BIN_COUNT];
+            uint32_t binCounts[BIN_COUNT] = {};
+            for (auto &bin : binBounds) bin = Bounds(glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX));
+            for (uint32_t i = first; i < first + count; i++) {
+                int bin = std::min(BIN_COUNT - 1, (int) ((centers[order[i]][axis] - centerBounds.min[axis]) * scale));
+                binBounds[bin] = binBounds[bin].merged(bounds[order[i]]);
+                binCounts[bin]++;
+            }
+
+            // sweep from the right, then from the left
+            float rightArea[BIN_COUNT];
+            uint32_t rightCount[BIN_COUNT];
+            Bounds right = binBounds[BIN_COUNT - 1];
+            uint32_t rightSum = 0;
+            for (int i = BIN_COUNT - 1; i > 0; i--) {
+                right = right.merged(binBounds[i]);
+                rightSum += binCounts[i];
+                rightArea[i] = rightSum ? right.surfaceArea() : 0.f;
+                rightCount[i] = rightSum;
+            }
+            Bounds left = binBounds[0];
+            uint32_t leftSum = 0;
+            for (int i = 1; i < BIN_COUNT; i++) {
+                left = left.merged(binBounds[i - 1]);
+                leftSum += binCounts[i - 1];
+                if (leftSum == 0 || rightCount[i] == 0) continue;
+                float cost = left.surfaceArea() * leftSum + rightArea[i] * rightCount[i];
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = i;
+                }
+            }
+        }
+        if (bestAxis < 0) continue;
+
+        float scale = BIN_COUNT / (centerBounds.max[bestAxis] - centerBounds.min[bestAxis]);
+        auto middle = std::partition(order.begin() + first, order.begin() + first + count, [&](uint32_t primitive) {
+            int bin = std::min(BIN_COUNT - 1, (int) ((centers[primitive][bestAxis] - centerBounds.min[bestAxis]) * scale));
+            return bin < bestSplit;
+        });
+        uint32_t leftCount = middle - (order.begin() + first);
+
+        uint32_t child = nodes.size();
+        nodes.push_back({glm::vec3(0), first, glm::vec3(0), leftCount});
+        nodes.push_back({glm::vec3(0), first + leftCount, glm::vec3(0), count - leftCount});
+        nodes[task.node].first = child;
+        nodes[task.node].count = 0;
+
+        tasks.push_back({child + 1, task.depth + 1});
+        tasks.push_back({child, task.depth + 1});
+    }
+
+    // leaf boxes in final order, the padding never overlaps anything
+    size_t padded = primitiveCount + simd::WIDTH;
+    minX.assign(padded, FLT_MAX); minY.assign(padded, FLT_MAX); minZ.assign(padded, FLT_MAX);
+    maxX.assign(padded, -FLT_MAX); maxY.assign(padded, -FLT_MAX); maxZ.assign(padded, -FLT_MAX);
+    leafData.resize(primitiveCount);
+    for (uint32_t i = 0; i < primitiveCount; i++) {
+        const Bounds &primitive = bounds[order[i]];
+        minX[i] = primitive.min.x; minY[i] = primitive.min.y; minZ[i] = primitive.min.z;
+        maxX[i] = primitive.max.x; maxY[i] = primitive.max.y; maxZ[i] = primitive.max.z;
+        leafData[i] = userData[order[i]];
+    }
+}
+
+int StaticBvh::overlapMask(uint32_t first, int count, const Bounds &bounds) const {
+    using namespace simd;
+    Float separated = (load(&minX[first]) > Float(bounds.max.x)) | (load(&maxX[first]) < Float(bounds.min.x))
+                    | (load(&minY[first]) > Float(bounds.max.y)) | (load(&maxY[first]) < Float(bounds.min.y))
+                    | (load(&minZ[first]) > Float(bounds.max.z)) | (load(&maxZ[first]) < Float(bounds.min.z));
+    return ~bits(separated) & ((1 << count) - 1);
+}
@@ -5,8 +5,13 @@
 #include <engine/include/camera.hpp>
 #include <engine/include/geometryHelper.hpp>
 #include <engine/include/animation.hpp>
+#include <engine/include/physicThread.hpp>
+#include <engine/include/jobSystem.hpp>
+#include <engine/include/simd.hpp>
 
+#include <algorithm>
 #include <iostream>
+#include <iterator>
 
 #include <assimp/cimport.h>
 #include <assimp/scene.h>
@@ -15,36 +20,115 @@
 
 void renderQuad();
 
-void Render::update(glm::mat4 &view, bool isCubemapRender) {
-        
+// while the physic thread runs, the transforms it moves are drawn from the poses published before its kick
+static glm::mat4 renderMatrix(Transform &transform, glm::vec3 &position){
+    glm::mat4 model;
+    if(PhysicThread::getInstance().getPose(&transform, model)){
+        position = glm::vec3(model[3]);
+        return model;
+    }
+    model = transform.getModelMatrix();
+    position = glm::vec3(model[3]);
+    return model;
+}
+
+void RenderQueue::clear(){
+    items.clear();
+    programRanks.clear();
+    materialRanks.clear();
+    meshRanks.clear();
+}
+
+void RenderQueue::push(Drawable &drawable, Program *program, Material *material, const glm::mat4 &model, float distance, int boneOffset){
+    RenderItem item;
+    item.drawable = &drawable;
+    item.program = program;
+    item.material = material;
+    item.model = model;
+    item.distance = distance;
+    item.boneOffset = boneOffset;
+    item.programRank = programRanks.emplace(program, programRanks.size()).first->second;
+    // drawables built without init have no key, their VAO stands for the mesh
+    uint64_t meshKey = drawable.meshKey ? drawable.meshKey : drawable.VAO;
+    item.meshRank = meshRanks.emplace(meshKey, meshRanks.size()).first->second;
+    item.materialRank = 0;
+    if(material){
+        MaterialKey materialKey = {
+            {material->albedo.x, material->albedo.y, material->albedo.z, material->metallic, material->roughness, material->ao},
+            {
+                material->albedoTex->visible ? material->albedoTex : nullptr,
+                material->normalTex->visible ? material->normalTex : nullptr,
+                material->metallicTex->visible ? material->metallicTex : nullptr,
+                material->roughnessTex->visible ? material->roughnessTex : nullptr,
+                material->aoTex->visible ? material->aoTex : nullptr
+            }
+        };
+        item.materialRank = materialRanks.emplace(materialKey, materialRanks.size()).first->second;
+    }
+    items.push_back(item);
+}
+
+void RenderQueue::sort(){
+    float maxDistance = 0.f;
+    for(auto &item: items) maxDistance = std::max(maxDistance, item.distance);
+    const uint64_t depthMax = (1 << 24) - 1;
+    float depthScale = maxDistance > 0.f ? depthMax / maxDistance : 0.f;
+
+    for(auto &item: items){
+        uint64_t depth = std::min<uint64_t>(depthMax, (uint64_t) std::max(0.f, item.distance * depthScale));
+        item.key = (uint64_t) std::min<uint16_t>(item.programRank, 0xFF) << 56
+                 | (uint64_t) item.materialRank << 40
+                 | (uint64_t) item.meshRank << 24
+                 | depth;
+    }
+    std::sort(items.begin(), items.end(), [](const RenderItem &a, const RenderItem &b){ return a.key < b.key; });
+}
+
+void Render::update(const VisibleSet *visible, bool isCubemapRender) {
+    glm::vec3 eye = CameraUniforms::getPosition();
+    queue.clear();
     for (const auto& entity : mEntities) {
+        if (visible && visible->isCulled(entity)) continue;
         auto& drawable = ecs.GetComponent<Drawable>(entity);
         if (isCubemapRender && drawable.hideOnCubemapRender) {
             continue;
         }
         auto& transform = ecs.GetComponent<Transform>(entity);
-        auto& program = *ecs.GetComponent<CustomProgram>(entity).programPtr;
-        
-        float distanceToCam = glm::length(Camera::getInstance().camera_position - transform.getLocalPosition());
-        
-        glUseProgram(program.programID);
-        program.beforeRender();
+        Program *program = ecs.GetComponent<CustomProgram>(entity).programPtr;
         
-        glm::mat4 model = transform.getModelMatrix();
-
-        program.renderTextures();
-
-        program.updateViewMatrix(view);
-        program.updateModelMatrix(model);
-        glm::mat4 camProj = Camera::getInstance().getP();
-        program.updateProjectionMatrix(camProj);
-
-        drawable.draw(distanceToCam);
-        program.afterRender();
+        glm::vec3 position;
+        glm::mat4 model = renderMatrix(transform, position);
+        float distanceToCam = glm::length(eye - position);
+        queue.push(drawable.lodAt(distanceToCam), program, nullptr, model, distanceToCam);
     }
+    queue.sort();
+
+    // the program state is only set when the program changes
+    Program *current = nullptr;
+    GLuint vao = 0;
+    for (auto &item : queue.getItems()) {
+        if (item.program != current) {
+            if (current) current->afterRender();
+            current = item.program;
+            glUseProgram(current->programID);
+            current->beforeRender();
+            current->renderTextures();
+            vao = 0;
+        }
+        if (item.drawable->VAO != vao) {
+            vao = item.drawable->VAO;
+            glBindVertexArray(vao);
+        }
+        current->updateModelMatrix(item.model);
+        item.drawable->drawElements();
+    }
+    glBindVertexArray(0);
+    if (current) current->afterRender();
 }
 
 PBR* PBRrender::pbrProgPtr = nullptr;
+GLuint PBRrender::bonePaletteBuffer = 0;
+GLuint PBRrender::bonePaletteTexture = 0;
 
 void PBRrender::initPBR() {
     if (!pbrProgPtr) {
@@ -58,101 +142,212 @@ void PBRrender::setupMaps(){
     PBR &pbrProg = *pbrProgPtr;
     glUseProgram(pbrProg.programID);
 
-    GLuint camLoc = glGetUniformLocation(pbrProg.programID, "camPos");
-    glm::vec3 C = Camera::getInstance().getPosition();
-    glUniform3f(camLoc, C.x, C.y, C.z);
-
     ////////// irradiance map
-    GLuint irrLoc = glGetUniformLocation(pbrProg.programID, "irradianceMap");
+    int irradianceUnit = current;
     glActiveTexture(GL_TEXTURE0 + current);
     glBindTexture(GL_TEXTURE_CUBE_MAP, mIrradianceMapID);
-    glUniform1i(irrLoc, current);
 
     ////////// prefilter map
-    GLuint prefiLoc = glGetUniformLocation(pbrProg.programID, "prefilterMap");
     current = Texture::getAvailableActivationInt();
+    int prefilterUnit = current;
     glActiveTexture(GL_TEXTURE0 + current);
     glBindTexture(GL_TEXTURE_CUBE_MAP, mPrefilterMapID);
-    glUniform1i(prefiLoc, current);
     ////////// brdf lut map
-    GLuint brdfLoc = glGetUniformLocation(pbrProg.programID, "brdfLUTMap");
     current = Texture::getAvailableActivationInt();
+    int brdfLUTUnit = current;
     glActiveTexture(GL_TEXTURE0 + current);
     glBindTexture(GL_TEXTURE_2D, mBrdfLUTID);
-    glUniform1i(brdfLoc, current);
+    ////////// bone palette, on its own unit even without skinned drawables: a samplerBuffer can't share one with the 2D samplers
+    current = Texture::getAvailableActivationInt();
+    glActiveTexture(GL_TEXTURE0 + current);
+    glBindTexture(GL_TEXTURE_BUFFER, bonePaletteTexture);
+
+    pbrProg.updateEnvironmentMaps(irradianceUnit, prefilterUnit, brdfLUTUnit);
+    pbrProg.updateBonePalette(current);
 }
 
-void PBRrender::update(glm::mat4 &view, bool isCubemapRender) {
+void PBRrender::update(const VisibleSet *visible, bool isCubemapRender) {
     setupMaps();
 
     PBR &pbrProg = *pbrProgPtr;
     pbrProg.beforeRender();
-    pbrProg.updateViewMatrix(view);
-    glm::mat4 camProj = Camera::getInstance().getP();
-    pbrProg.updateProjectionMatrix(camProj);
 
+    glm::vec3 eye = CameraUniforms::getPosition();
+    queue.clear();
     for (const auto& entity : mEntities) {
+        if (visible && visible->isCulled(entity)) continue;
         auto& drawable = ecs.GetComponent<Drawable>(entity);
         if (isCubemapRender && drawable.hideOnCubemapRender) {
             continue;
         }
         auto& transform = ecs.GetComponent<Transform>(entity);
         auto& material = ecs.GetComponent<Material>(entity);
-
-        pbrProg.updateMaterial(material);
-        
-        float distanceToCam = glm::length(Camera::getInstance().camera_position - transform.getLocalPosition());
         
-        glm::mat4 model = transform.getModelMatrix();
-
-        pbrProg.renderTextures();
-        pbrProg.updateModelMatrix(model);
-
-        drawable.draw(distanceToCam);
+        glm::vec3 position;
+        glm::mat4 model = renderMatrix(transform, position);
+        float distanceToCam = glm::length(eye - position);
+        queue.push(drawable.lodAt(distanceToCam), pbrProgPtr, &material, model, distanceToCam);
     }
+    queue.sort();
+
+    // the material uniforms and textures are only uploaded when the material changes, runs of the same mesh
+    // and material are drawn in one instanced call
+    pbrProg.renderTextures();
+    uploadInstances();
+    drawCalls = 0;
+    const auto &items = queue.getItems();
+    int materialRank = -1;
+    GLuint vao = 0;
+    for (size_t first = 0; first < items.size();) {
+        const RenderItem &item = items[first];
+        size_t last = first + 1;
+        while (last < items.size() && items[last].materialRank == item.materialRank && items[last].meshRank == item.meshRank) last++;
+
+        if (item.materialRank != materialRank) {
+            materialRank = item.materialRank;
+            pbrProg.updateMaterial(*item.material);
+        }
+        // drawables of the same mesh may have their own VAO, any of them draws the run
+        if (item.drawable->VAO != vao) {
+            vao = item.drawable->VAO;
+            glBindVertexArray(vao);
+        }
+        if (last - first >= minInstances) {
+            drawInstanced(item, first, last - first);
+        } else {
+            for (size_t i = first; i < last; i++) {
+                pbrProg.updateModelMatrix(items[i].model);
+                items[i].drawable->drawElements();
+                drawCalls++;
+            }
+        }
+        first = last;
+    }
+    glBindVertexArray(0);
     pbrProg.afterRender();
 }
 
+void PBRrender::uploadInstances() {
+    const auto &items = queue.getItems();
+    instanceModels.resize(items.size());
+    for (size_t i = 0; i < items.size(); i++) instanceModels[i] = items[i].model;
+    if (instanceModels.empty()) return;
+
+    if (!instanceBuffer) glGenBuffers(1, &instanceBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    if (instanceModels.size() > instanceCapacity) {
+        instanceCapacity = std::max(instanceModels.size(), 2 * instanceCapacity);
+        glBufferData(GL_ARRAY_BUFFER, instanceCapacity * sizeof(glm::mat4), nullptr, GL_DYNAMIC_DRAW);
+        uploadedModels.clear();
+    }
 
-void AnimatedPBRrender::update(glm::mat4 &view, float deltaTime){
-    setupMaps();
+    // most of the scene doesn't move between two frames, only the range between the first and the last change is sent
+    size_t begin = 0, end = instanceModels.size();
+    size_t common = std::min(instanceModels.size(), uploadedModels.size());
+    while (begin < common && instanceModels[begin] == uploadedModels[begin]) begin++;
+    if (end == uploadedModels.size()) {
+        while (end > begin && instanceModels[end - 1] == uploadedModels[end - 1]) end--;
+    }
+    if (begin < end) {
+        glBufferSubData(GL_ARRAY_BUFFER, begin * sizeof(glm::mat4), (end - begin) * sizeof(glm::mat4), &instanceModels[begin]);
+    }
+    uploadedModels = instanceModels;
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
 
-    PBR &pbrProg = *pbrProgPtr;
-    pbrProg.beforeRender();
-    pbrProg.updateViewMatrix(view);
-    glm::mat4 camProj = Camera::getInstance().getP();
-    pbrProg.updateProjectionMatrix(camProj);
+void PBRrender::drawInstanced(const RenderItem &item, size_t first, size_t count) {
+    const GLuint location = 5;
+    pbrProgPtr->setInstanced(true);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    for (GLuint column = 0; column < 4; column++) {
+        glEnableVertexAttribArray(location + column);
+        glVertexAttribPointer(location + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4),
+                              (void*)(first * sizeof(glm::mat4) + column * sizeof(glm::vec4)));
+        glVertexAttribDivisor(location + column, 1);
+    }
+    glDrawElementsInstanced(GL_TRIANGLES, item.drawable->indexCount, GL_UNSIGNED_SHORT, (void*)0, count);
+    drawCalls++;
+    // the attributes belong to the VAO of the run, its single draws read the model uniform again
+    for (GLuint column = 0; column < 4; column++) {
+        glVertexAttribDivisor(location + column, 0);
+        glDisableVertexAttribArray(location + column);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    pbrProgPtr->setInstanced(false);
+}
 
+void AnimatedPBRrender::uploadPalette(){
+    bool created = !bonePaletteBuffer;
+    if(created){
+        glGenBuffers(1, &bonePaletteBuffer);
+        glGenTextures(1, &bonePaletteTexture);
+    }
+    // respecified every update so the driver can hand a new storage while the last draws still read the old one
+    glBindBuffer(GL_TEXTURE_BUFFER, bonePaletteBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, std::max<size_t>(palette.size(), 1) * sizeof(glm::mat4), palette.empty() ? nullptr : palette.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    // the buffer only exists once bound
+    if(created){
+        glBindTexture(GL_TEXTURE_BUFFER, bonePaletteTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, bonePaletteBuffer);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+    }
+}
+
+void AnimatedPBRrender::update(float deltaTime, const VisibleSet *visible){
+    // poses of every drawn entity first, they go to the GPU in one upload
+    glm::vec3 eye = CameraUniforms::getPosition();
+    palette.clear();
+    queue.clear();
+    std::vector<glm::mat4> inMatrices, outMatrices;
     for (const auto& entity : mEntities) {
         auto& drawable = ecs.GetComponent<AnimatedDrawable>(entity);
-        auto& transform = ecs.GetComponent<Transform>(entity);
-        auto& material = ecs.GetComponent<Material>(entity);
-        
-        pbrProg.updateMaterial(material);
-        
-        float distanceToCam = glm::length(Camera::getInstance().camera_position - transform.getLocalPosition());
-        
-        glm::mat4 model = transform.getModelMatrix();
-        
-        pbrProg.renderTextures();
-        pbrProg.updateModelMatrix(model);
-        
         if(drawable.playing){
             drawable.animation.addDeltaTime(deltaTime);
         }
-        std::vector<glm::mat4> inMatrices, outMatrices;
-        
+        // the animation keeps its time off screen
+        if (visible && visible->isCulled(entity)) continue;
+
+        inMatrices.clear();
         drawable.animation.getPose(drawable.bones, inMatrices);
-        
         CalculateAnimationPose(drawable.bones, inMatrices, outMatrices);
-        for (int i = 0; i < outMatrices.size(); i++) {
-            std::string uniformName = "bones[" + std::to_string(i) + "]";
-            GLuint mLoc = glGetUniformLocation(pbrProg.programID, uniformName.c_str());
-            glUniformMatrix4fv(mLoc, 1, GL_FALSE, &outMatrices[i][0][0]);
-        }
 
-        drawable.draw(distanceToCam);
+        auto& transform = ecs.GetComponent<Transform>(entity);
+        auto& material = ecs.GetComponent<Material>(entity);
+        glm::vec3 position;
+        glm::mat4 model = renderMatrix(transform, position);
+        float distanceToCam = glm::length(eye - position);
+        queue.push(drawable.lodAt(distanceToCam), pbrProgPtr, &material, model, distanceToCam, palette.size());
+        palette.insert(palette.end(), outMatrices.begin(), outMatrices.end());
+    }
+    uploadPalette();
+    queue.sort();
+
+    setupMaps();
+
+    PBR &pbrProg = *pbrProgPtr;
+    pbrProg.beforeRender();
+
+    // same state changes as PBRrender::update, but one draw per item: each one reads its own bone matrices
+    pbrProg.renderTextures();
+    drawCalls = 0;
+    int materialRank = -1;
+    GLuint vao = 0;
+    for (auto &item : queue.getItems()) {
+        if (item.materialRank != materialRank) {
+            materialRank = item.materialRank;
+            pbrProg.updateMaterial(*item.material);
+        }
+        if (item.drawable->VAO != vao) {
+            vao = item.drawable->VAO;
+            glBindVertexArray(vao);
+        }
+        pbrProg.updateModelMatrix(item.model);
+        pbrProg.updateBoneOffset(item.boneOffset);
+        item.drawable->drawElements();
+        drawCalls++;
     }
+    glBindVertexArray(0);
     pbrProg.afterRender();
 }
 
@@ -687,15 +882,15 @@ void CubemapRender::applyPrefilter(Program* prefilterProg, Cubemap prefilterMap)
     glBindTexture(GL_TEXTURE_CUBE_MAP, cubemap.textureID);
 
     prefilterProg->use();
-    GLuint skyLoc = glGetUniformLocation(prefilterProg->programID, "environmentMap");
     int current = Texture::getAvailableActivationInt();
     glActiveTexture(GL_TEXTURE0 + current);
     glBindTexture(GL_TEXTURE_CUBE_MAP, cubemap.textureID);
-    glUniform1i(skyLoc, current);
+    prefilterProg->setInt("environmentMap", current);
     
     prefilterProg->beforeRender();
-    prefilterProg->updateProjectionMatrix(projection);
     prefilterProg->updateModelMatrix(glm::mat4(1.0f));
+    glm::mat4 savedView = CameraUniforms::getView();
+    glm::mat4 savedProjection = CameraUniforms::getProjection();
 
     const unsigned int maxMipLevels = 5;
     for (unsigned int mip = 0; mip < maxMipLevels; ++mip) {
@@ -712,7 +907,7 @@ void CubemapRender::applyPrefilter(Program* prefilterProg, Cubemap prefilterMap)
         for (int face = 0; face < 6; ++face) {
             
             glm::mat4 view = glm::lookAt(glm::vec3(0.0f), orientations[face], ups[face]);
-            prefilterProg->updateViewMatrix(view);
+            CameraUniforms::set(view, projection);
 
             glFramebufferTexture2D(
                 GL_FRAMEBUFFER,
@@ -732,6 +927,7 @@ void CubemapRender::applyPrefilter(Program* prefilterProg, Cubemap prefilterMap)
 
 
     prefilterProg->afterRender();
+    CameraUniforms::set(savedView, savedProjection);
     glViewport(oldViewport[0], oldViewport[1], oldViewport[2], oldViewport[3]);
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
     glDeleteRenderbuffers(1, &rbo);
@@ -804,15 +1000,15 @@ void CubemapRender::applyFilter(Program *filterProg, Cubemap target){
 
     filterProg->use();
 
-    GLuint skyLoc = glGetUniformLocation(filterProg->programID, "skybox");
     int current = Texture::getAvailableActivationInt();
     glActiveTexture(GL_TEXTURE0 + current);
     glBindTexture(GL_TEXTURE_CUBE_MAP, cubemap.textureID);
-    glUniform1i(skyLoc, current);
+    filterProg->setInt("skybox", current);
 
     filterProg->beforeRender();
-    filterProg->updateProjectionMatrix(projection);
     filterProg->updateModelMatrix(glm::mat4(1));
+    glm::mat4 savedView = CameraUniforms::getView();
+    glm::mat4 savedProjection = CameraUniforms::getProjection();
 
     for(int i = 0; i < 6; i++){
         glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
@@ -822,13 +1018,12 @@ void CubemapRender::applyFilter(Program *filterProg, Cubemap target){
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         glm::mat4 view = glm::lookAt(glm::vec3(0), orientations[i], ups[i]);
-        filterProg->updateViewMatrix(view);
+        CameraUniforms::set(view, projection);
 
         cubeMesh.draw(-1);
     }
 
-    glm::mat4 camProj = Camera::getInstance().getP();
-    filterProg->updateProjectionMatrix(camProj);
+    CameraUniforms::set(savedView, savedProjection);
     filterProg->afterRender();
 
     glViewport(m_viewport[0],m_viewport[1], m_viewport[2], m_viewport[3]);
@@ -837,7 +1032,7 @@ void CubemapRender::applyFilter(Program *filterProg, Cubemap target){
 }
 
 
-void CubemapRender::renderFromPoint(glm::vec3 point, Render *render, PBRrender *pbr){
+void CubemapRender::renderFromPoint(glm::vec3 point, Render *render, PBRrender *pbr, BoundsSystem *bounds){
     GLuint fbo;
     glGenFramebuffers(1, &fbo);
     glBindFramebuffer(GL_FRAMEBUFFER, fbo);
@@ -858,24 +1053,22 @@ void CubemapRender::renderFromPoint(glm::vec3 point, Render *render, PBRrender *
     glGetIntegerv( GL_VIEWPORT, m_viewport );
     glViewport(0,0, cubemap.resolution, cubemap.resolution);
 
-    for(auto &prog:Program::programs){
-        prog->updateProjectionMatrix(projection);
-    }
+    glm::mat4 savedView = CameraUniforms::getView();
+    glm::mat4 savedProjection = CameraUniforms::getProjection();
+    VisibleSet visible;
     for(int i=0; i<6; i++){
         glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, cubemap.textureID, 0);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
         auto dir = orientations[i];
         
         glm::mat4 view = glm::lookAt(point, point + dir, ups[i]);
+        CameraUniforms::set(view, projection);
+        if(bounds) bounds->cull(projection * view, visible);
         
-        render->update(view, true);
-        pbr->update(view, true);
-    }
-
-    glm::mat4 camProjection = Camera::getInstance().getP();
-    for(auto &prog:Program::programs){
-        prog->updateProjectionMatrix(camProjection);
+        render->update(bounds ? &visible : nullptr, true);
+        pbr->update(bounds ? &visible : nullptr, true);
     }
+    CameraUniforms::set(savedView, savedProjection);
 
     glViewport(m_viewport[0],m_viewport[1], m_viewport[2], m_viewport[3]);
     glDeleteRenderbuffers(1, &depthBufffer);
@@ -1132,6 +1325,109 @@ Drawable Render::generateCube(float sideLength, int verticesPerSide, bool inward
 }
 
 
+void BoundsSystem::update(){
+    if(tracked.empty()){
+        bounds.resize(MAX_ENTITIES);
+        spheres.resize(MAX_ENTITIES);
+        versions.assign(MAX_ENTITIES, 0);
+        transformVersions.assign(MAX_ENTITIES, 0);
+        tracked.assign(MAX_ENTITIES, false);
+    }
+
+    // both sets are sorted, the dense list stays ascending for the visible lists
+    denseEntities.clear();
+    if(animated) std::set_union(mEntities.begin(), mEntities.end(), animated->mEntities.begin(), animated->mEntities.end(), std::back_inserter(denseEntities));
+    else denseEntities.assign(mEntities.begin(), mEntities.end());
+
+    // entities that left the system are refreshed if they come back, whatever their transform version
+    for(auto &entity: trackedEntities){
+        if(!std::binary_search(denseEntities.begin(), denseEntities.end(), entity)) tracked[entity] = false;
+    }
+    trackedEntities = denseEntities;
+
+    refreshCount = 0;
+    for(auto &entity: denseEntities){
+        auto &transform = ecs.GetComponent<Transform>(entity);
+        if(tracked[entity] && transformVersions[entity] == transform.getVersion()) continue;
+
+        if(mEntities.count(entity)){
+            auto &drawable = ecs.GetComponent<Drawable>(entity);
+            refresh(entity, drawable.localBounds, drawable.localSphere, transform);
+        } else {
+            auto &drawable = ecs.GetComponent<AnimatedDrawable>(entity);
+            glm::vec3 extents = drawable.localBounds.extents();
+            float padding = animatedPadding * std::max(extents.x, std::max(extents.y, extents.z));
+            Bounds local(drawable.localBounds.min - glm::vec3(padding), drawable.localBounds.max + glm::vec3(padding));
+            BoundingSphere localSphere(drawable.localSphere.center, drawable.localSphere.radius + padding);
+            refresh(entity, local, localSphere, transform);
+        }
+    }
+
+    size_t padded = (denseEntities.size() + simd::WIDTH - 1) / simd::WIDTH * simd::WIDTH;
+    centersX.assign(padded, 0.f);
+    centersY.assign(padded, 0.f);
+    centersZ.assign(padded, 0.f);
+    radii.assign(padded, 0.f);
+    for(size_t i = 0; i < denseEntities.size(); i++){
+        const BoundingSphere &sphere = spheres[denseEntities[i]];
+        centersX[i] = sphere.center.x;
+        centersY[i] = sphere.center.y;
+        centersZ[i] = sphere.center.z;
+        radii[i] = sphere.radius;
+    }
+}
+
+void BoundsSystem::refresh(Entity entity, const Bounds &local, const BoundingSphere &localSphere, Transform &transform){
+    glm::mat4 model = transform.getModelMatrix();
+    bounds[entity] = local.transformed(model);
+    spheres[entity] = localSphere.transformed(model);
+    transformVersions[entity] = transform.getVersion();
+    tracked[entity] = true;
+    versions[entity]++;
+    refreshCount++;
+}
+
+void BoundsSystem::cull(const glm::mat4 &viewProjection, VisibleSet &out){
+    using namespace simd;
+    size_t count = denseEntities.size();
+    out.entities.clear();
+    out.culledFlags.assign(MAX_ENTITIES, false);
+    out.tested = count;
+    out.culled = 0;
+    if(count == 0) return;
+
+    Frustum frustum = Frustum::fromMatrix(viewProjection);
+    JobSystem &jobs = JobSystem::getInstance();
+    size_t groups = (count + WIDTH - 1) / WIDTH;
+    size_t minGroupsPerChunk = std::max<size_t>(1, minSpheresPerChunk / WIDTH);
+    chunkVisible.resize(jobs.chunkCount(groups, minGroupsPerChunk));
+
+    jobs.parallelFor(groups, minGroupsPerChunk, [&](size_t begin, size_t end, unsigned chunk){
+        auto &visible = chunkVisible[chunk];
+        visible.clear();
+        for(size_t group = begin; group < end; group++){
+            size_t first = group * WIDTH;
+            Float x = load(&centersX[first]), y = load(&centersY[first]), z = load(&centersZ[first]);
+            Float minusRadius = -load(&radii[first]);
+            Float outside(0.f);
+            for(auto &plane: frustum.planes){
+                Float distance = Float(plane.x) * x + Float(plane.y) * y + Float(plane.z) * z + Float(plane.w);
+                outside = outside | (distance < minusRadius);
+            }
+            int outsideBits = bits(outside);
+            size_t lanes = std::min<size_t>(WIDTH, count - first);
+            for(size_t lane = 0; lane < lanes; lane++){
+                Entity entity = denseEntities[first + lane];
+                if(outsideBits & (1 << lane)) out.culledFlags[entity] = true;
+                else visible.push_back(entity);
+            }
+        }
+    });
+
+    for(auto &visible: chunkVisible) out.entities.insert(out.entities.end(), visible.begin(), visible.end());
+    out.culled = count - out.entities.size();
+}
+
 void CameraSystem::update(){
     for (const auto& entity : mEntities) {
         auto& cam = ecs.GetComponent<CameraComponent>(entity);
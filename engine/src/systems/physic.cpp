@@ -1,51 +1,511 @@
 #include <engine/include/ecs/implementations/systems.hpp>
 #include <engine/include/ecs/ecsManager.hpp>
 #include <iostream>
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
 #include <engine/include/camera.hpp>
+#include <engine/include/jobSystem.hpp>
+#include <engine/include/simd.hpp>
+#include <engine/include/spatial.hpp>
 
 const float G = 9.81f;
 
 std::vector<OverlapingShape> detectedCollisions;
 
+using StatsClock = std::chrono::steady_clock;
+
+static double millisecondsSince(StatsClock::time_point start){
+    return std::chrono::duration<double, std::milli>(StatsClock::now() - start).count();
+}
+
 void CollisionDetectionSystem::update(float deltaTime){
+    auto start = StatsClock::now();
+    broadPhase();
+    stats.broadPhaseTime = millisecondsSince(start);
+
+    start = StatsClock::now();
     narrowPhase();
+    stats.narrowPhaseTime = millisecondsSince(start);
+    stats.contacts = detectedCollisions.size();
 }
 
-void CollisionDetectionSystem::narrowPhase(){
-    detectedCollisions.clear();
+bool CollisionDetectionSystem::shouldBeStatic(Entity entity){
+    return ecs.HasComponent<RigidBody>(entity) && ecs.GetComponent<RigidBody>(entity).type == RigidBody::STATIC;
+}
+
+void CollisionDetectionSystem::buildStaticTree(){
+    if(proxies.empty()){
+        proxies.assign(MAX_ENTITIES, AabbTree::NULL_NODE);
+        shapes.assign(MAX_ENTITIES, nullptr);
+        entityBounds.resize(MAX_ENTITIES);
+        isStatic.assign(MAX_ENTITIES, false);
+        hasBounds.assign(MAX_ENTITIES, false);
+        staticMatrices.resize(MAX_ENTITIES);
+    }
+    std::fill(isStatic.begin(), isStatic.end(), false);
+
+    std::vector<Bounds> staticBounds;
+    std::vector<uint32_t> staticEntities;
     for(auto &entity: mEntities){
-        ecs.GetComponent<CollisionShape>(entity).collidingEntities.clear();
+        isStatic[entity] = shouldBeStatic(entity);
+        if(!isStatic[entity]) continue;
+
+        auto &shape = ecs.GetComponent<CollisionShape>(entity);
+        auto &transform = ecs.GetComponent<Transform>(entity);
+        shape.updateWorld(transform);
+        shapes[entity] = &shape;
+        staticMatrices[entity] = transform.getModelMatrix();
+
+        if(proxies[entity] != AabbTree::NULL_NODE) tree.destroyProxy(proxies[entity]);
+        proxies[entity] = AabbTree::NULL_NODE;
+
+        hasBounds[entity] = shape.worldBounds(entityBounds[entity]);
+        if(hasBounds[entity]){
+            staticBounds.push_back(entityBounds[entity]);
+            staticEntities.push_back(entity);
+        }
     }
+    staticTree.build(staticBounds, staticEntities);
+    staticTreeDirty = false;
+}
+
+// refresh world colliders and keep one tree proxy per bounded moving shape
+void CollisionDetectionSystem::updateProxies(){
+    if(proxies.empty()) buildStaticTree();
+
+    for(auto &entity: trackedEntities){
+        if(mEntities.find(entity) != mEntities.end()) continue;
+        if(proxies[entity] != AabbTree::NULL_NODE) tree.destroyProxy(proxies[entity]);
+        if(isStatic[entity]) staticTreeDirty = true;
+        proxies[entity] = AabbTree::NULL_NODE;
+        shapes[entity] = nullptr;
+        isStatic[entity] = false;
+    }
+    trackedEntities.assign(mEntities.begin(), mEntities.end());
+
+    unboundedEntities.clear();
+    for(auto &entity: mEntities){
+        auto &shape = ecs.GetComponent<CollisionShape>(entity);
+        auto &transform = ecs.GetComponent<Transform>(entity);
+        shape.collidingEntities.clear();
+        shapes[entity] = &shape;
+
+        if(isStatic[entity]){
+            // still where the static tree was built: nothing to refresh
+            if(shouldBeStatic(entity) && transform.getModelMatrix() == staticMatrices[entity]){
+                if(!hasBounds[entity]) unboundedEntities.push_back(entity);
+                continue;
+            }
+            staticTreeDirty = true;
+        } else if(shouldBeStatic(entity)){
+            staticTreeDirty = true;
+        }
+
+        shape.updateWorld(transform);
+        int &proxy = proxies[entity];
+        hasBounds[entity] = shape.worldBounds(entityBounds[entity]);
+        if(hasBounds[entity]){
+            if(proxy == AabbTree::NULL_NODE) proxy = tree.createProxy(entityBounds[entity], entity);
+            else tree.moveProxy(proxy, entityBounds[entity]);
+        } else {
+            if(proxy != AabbTree::NULL_NODE) tree.destroyProxy(proxy);
+            proxy = AabbTree::NULL_NODE;
+            unboundedEntities.push_back(entity);
+        }
+    }
+
+    if(staticTreeDirty) buildStaticTree();
+}
+
+// pairs come out in the order of the former all pairs loop: entityA ascending, then entityB ascending,
+// without the static-static ones
+void CollisionDetectionSystem::broadPhase(){
+    candidatePairs.clear();
+    updateProxies();
+    stats.proxies = 0;
+    stats.unbounded = unboundedEntities.size();
+    stats.layerRejectedPairs = 0;
 
     for(auto itA=mEntities.begin(); itA != mEntities.end(); itA++){
         const auto &entityA = *itA;
-        auto& transformA = ecs.GetComponent<Transform>(entityA);
-        auto& shapeA = ecs.GetComponent<CollisionShape>(entityA);
+        auto& shapeA = *shapes[entityA];
+        bool staticA = isStatic[entityA];
+
+        partners.clear();
+        if(hasBounds[entityA]) stats.proxies++;
+        if(!hasBounds[entityA]){
+            for(auto itB = std::next(itA); itB != mEntities.end(); itB++){
+                if(!staticA || !isStatic[*itB]) partners.push_back(*itB);
+            }
+        } else {
+            auto collect = [&](uint32_t entityB){
+                if(entityB > entityA) partners.push_back(entityB);
+                return true;
+            };
+            tree.query(entityBounds[entityA], collect);
+            if(!staticA) staticTree.query(entityBounds[entityA], collect);
+            for(auto &entityB: unboundedEntities){
+                if(entityB > entityA && (!staticA || !isStatic[entityB])) partners.push_back(entityB);
+            }
+            std::sort(partners.begin(), partners.end());
+        }
 
-        auto itB = itA;
-        itB ++;
-        for(; itB != mEntities.end(); itB++){
-            const auto &entityB = *itB;
-            auto& transformB = ecs.GetComponent<Transform>(entityB);
-            auto& shapeB = ecs.GetComponent<CollisionShape>(entityB);
+        for(auto &entityB: partners){
+            auto& shapeB = *shapes[entityB];
 
             bool aSeeB = CollisionShape::canSee(shapeA, shapeB);
             bool bSeeA = CollisionShape::canSee(shapeB, shapeA);
 
-            if(!aSeeB && !bSeeA) continue;
+            if(!aSeeB && !bSeeA){
+                stats.layerRejectedPairs++;
+                continue;
+            }
+
+            candidatePairs.push_back({entityA, entityB, &shapeA, &shapeB, aSeeB, bSeeA});
+        }
+    }
+
+    stats.candidatePairs = candidatePairs.size();
+    for(auto &tests: stats.narrowTests) std::fill(std::begin(tests), std::end(tests), 0);
+    for(auto &pair: candidatePairs){
+        int a = pair.shapeA->shapeType, b = pair.shapeB->shapeType;
+        stats.narrowTests[std::min(a, b)][std::max(a, b)]++;
+    }
+}
+
+void CollisionDetectionSystem::narrowPhase(){
+    detectedCollisions.clear();
+
+    auto &jobs = JobSystem::getInstance();
+    unsigned chunks = jobs.chunkCount(candidatePairs.size(), minPairsPerChunk);
+    if(chunkContacts.size() < chunks) chunkContacts.resize(chunks);
+    for(unsigned i=0; i<chunks; i++) chunkContacts[i].clear();
+
+    jobs.parallelFor(candidatePairs.size(), minPairsPerChunk, [this](size_t begin, size_t end, unsigned chunk){
+        auto &contacts = chunkContacts[chunk];
+        auto addContact = [&](const CandidatePair &pair, OverlapingShape &collision){
+            if(!collision.exist && !collision.triggerA && !collision.triggerB) return;
+            collision.aSeeB = pair.aSeeB;
+            collision.bSeeA = pair.bSeeA;
+            collision.entityA = pair.entityA;
+            collision.entityB = pair.entityB;
+            contacts.push_back(collision);
+        };
+
+        for(size_t i=begin; i<end;){
+            const auto &pair = candidatePairs[i];
+
+            // pairs are sorted by entityA: the following box-box pairs against the same box go through the simd kernel together
+            if(pair.shapeA->shapeType == OOBB && pair.shapeB->shapeType == OOBB){
+                size_t batchEnd = i + 1;
+                while(batchEnd < end && batchEnd - i < (size_t) simd::WIDTH
+                    && candidatePairs[batchEnd].shapeA == pair.shapeA
+                    && candidatePairs[batchEnd].shapeB->shapeType == OOBB) batchEnd++;
+
+                if(batchEnd - i > 1){
+                    int count = batchEnd - i;
+                    WorldOobbBatch batch;
+                    for(int lane=0; lane<count; lane++){
+                        const auto &other = candidatePairs[i + lane];
+                        batch.set(lane, other.shapeB->world.oobb);
+                    }
+                    batch.clear(count);
+                    OverlapingShape results[simd::WIDTH];
+                    oobbIntersectionBatch(pair.shapeA->world.oobb, batch, count, results);
+                    for(int lane=0; lane<count; lane++) addContact(candidatePairs[i + lane], results[lane]);
+                    i = batchEnd;
+                    continue;
+                }
+            }
+
+            OverlapingShape collision = CollisionShape::intersectionExist(*pair.shapeA, *pair.shapeB);
+            addContact(pair, collision);
+            i++;
+        }
+    });
+
+    // chunks cover the pair list in order, so the merged list matches the serial one
+    for(unsigned i=0; i<chunks; i++){
+        for(auto &collision: chunkContacts[i]){
+            if(collision.triggerA) ecs.GetComponent<CollisionShape>(collision.entityA).collidingEntities.emplace(collision.entityB);
+            if(collision.triggerB) ecs.GetComponent<CollisionShape>(collision.entityB).collidingEntities.emplace(collision.entityA);
+            if(!collision.exist) continue;
+            if(collision.aSeeB) ecs.GetComponent<CollisionShape>(collision.entityA).collidingEntities.emplace(collision.entityB);
+            if(collision.bSeeA) ecs.GetComponent<CollisionShape>(collision.entityB).collidingEntities.emplace(collision.entityA);
+            detectedCollisions.push_back(collision);
+        }
+    }
+}
+
+bool CollisionDetectionSystem::raycast(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance, uint16_t mask, RaycastHit &hit) const {
+    hit = RaycastHit();
+    if(shapes.empty() || glm::length(direction) < 0.0001f) return false;
+    glm::vec3 unitDirection = glm::normalize(direction);
+
+    auto test = [&](uint32_t entity, float maxDistance){
+        const CollisionShape &shape = *shapes[entity];
+        if(!(shape.layer & mask)) return maxDistance;
+
+        glm::vec3 normal;
+        float distance = shape.rayIntersection(origin, unitDirection, maxDistance, normal);
+        if(distance < 0.f || (hit.hit && distance >= hit.distance)) return maxDistance;
+
+        hit.hit = true;
+        hit.entity = entity;
+        hit.distance = distance;
+        hit.normal = normal;
+        hit.position = origin + unitDirection * distance;
+        return distance;
+    };
+
+    tree.raycast(origin, unitDirection, maxDistance, test);
+    staticTree.raycast(origin, unitDirection, hit.hit ? hit.distance : maxDistance, test);
+    for(auto &entity: unboundedEntities){
+        test(entity, hit.hit ? hit.distance : maxDistance);
+    }
+    return hit.hit;
+}
+
+bool CollisionDetectionSystem::sphereCast(const glm::vec3 &origin, float radius, const glm::vec3 &direction, float maxDistance, uint16_t mask, RaycastHit &hit) const {
+    hit = RaycastHit();
+    if(shapes.empty() || glm::length(direction) < 0.0001f) return false;
+    glm::vec3 displacement = glm::normalize(direction) * maxDistance;
+
+    CollisionShape sphere;
+    sphere.shapeType = SPHERE;
+    sphere.sphere.radius = radius;
+    sphere.world.position = origin;
+
+    auto test = [&](uint32_t entity){
+        const CollisionShape &shape = *shapes[entity];
+        if(!(shape.layer & mask)) return true;
+
+        glm::vec3 normal;
+        float t;
+        if(CollisionShape::intersectionExist(sphere, shape).exist){
+            t = 0.f;
+            normal = -glm::normalize(displacement);
+        } else {
+            t = CollisionShape::timeOfImpact(sphere, origin, displacement, shape, normal);
+            if(t < 0.f) return true;
+        }
+
+        float distance = t * maxDistance;
+        if(hit.hit && distance >= hit.distance) return true;
+        hit.hit = true;
+        hit.entity = entity;
+        hit.distance = distance;
+        hit.normal = normal;
+        hit.position = origin + displacement * t - normal * radius;
+        return true;
+    };
+
+    Bounds start = Bounds::fromCenter(origin, glm::vec3(radius));
+    Bounds end = Bounds::fromCenter(origin + displacement, glm::vec3(radius));
+    tree.query(start.merged(end), test);
+    staticTree.query(start.merged(end), test);
+    for(auto &entity: unboundedEntities) test(entity);
+    return hit.hit;
+}
+
+template<typename Test>
+void CollisionDetectionSystem::overlapQuery(const Bounds &bounds, uint16_t mask, Test test, std::vector<Entity> &results) const {
+    results.clear();
+    if(shapes.empty()) return;
+
+    auto check = [&](uint32_t entity){
+        const CollisionShape &shape = *shapes[entity];
+        if((shape.layer & mask) && test(shape)) results.push_back(entity);
+        return true;
+    };
+    tree.query(bounds, check);
+    staticTree.query(bounds, check);
+    for(auto &entity: unboundedEntities) check(entity);
+    std::sort(results.begin(), results.end());
+}
+
+void CollisionDetectionSystem::overlapSphere(const glm::vec3 &center, float radius, uint16_t mask, std::vector<Entity> &results) const {
+    CollisionShape sphere;
+    sphere.shapeType = SPHERE;
+    sphere.sphere.radius = radius;
+    sphere.world.position = center;
+
+    overlapQuery(Bounds::fromCenter(center, glm::vec3(radius)), mask, [&](const CollisionShape &shape){
+        return CollisionShape::intersectionExist(sphere, shape).exist;
+    }, results);
+}
+
+void CollisionDetectionSystem::overlapBox(const glm::vec3 &center, const glm::vec3 &halfExtents, const glm::quat &rotation, uint16_t mask, std::vector<Entity> &results) const {
+    CollisionShape box;
+    box.shapeType = OOBB;
+    box.oobb.halfExtents = halfExtents;
+    box.world.modelMatrix = glm::translate(glm::mat4(1.f), center) * glm::mat4_cast(rotation);
+    box.world.invModelMatrix = glm::inverse(box.world.modelMatrix);
+    box.world.position = center;
+    box.world.oobb = box.oobb.toWorld(box.world.modelMatrix);
+
+    Bounds bounds;
+    box.worldBounds(bounds);
+    overlapQuery(bounds, mask, [&](const CollisionShape &shape){
+        return CollisionShape::intersectionExist(box, shape).exist;
+    }, results);
+}
+
+void CollisionDetectionSystem::raycastBatch(const std::vector<RayQuery> &rays, std::vector<RaycastHit> &hits) const {
+    hits.resize(rays.size());
+    JobSystem::getInstance().parallelFor(rays.size(), 32, [&](size_t begin, size_t end, unsigned){
+        for(size_t i=begin; i<end; i++){
+            raycast(rays[i].origin, rays[i].direction, rays[i].maxDistance, rays[i].mask, hits[i]);
+        }
+    });
+}
+
+void GravityFieldSystem::update(){
+    sourcePositions.clear();
+    sourceMasses.clear();
+    for(auto &entity: mEntities){
+        sourcePositions.push_back(ecs.GetComponent<Transform>(entity).getGlobalPosition());
+        sourceMasses.push_back(ecs.GetComponent<GravitySource>(entity).mass);
+    }
+    octree.gravitationalConstant = gravitationalConstant;
+    octree.softening = softening;
+    octree.build(sourcePositions, sourceMasses);
+}
+
+glm::vec3 GravityFieldSystem::fieldAt(const glm::vec3 &point) const {
+    return exact ? octree.exactField(point) : octree.field(point, theta);
+}
 
-            OverlapingShape collision = CollisionShape::intersectionExist(shapeA, transformA, shapeB, transformB);
+void GravityFieldSystem::evaluate(const std::vector<float> (&position)[3], const std::vector<float> &mask, std::vector<float> (&field)[3], size_t count) const {
+    // each point only reads the octree
+    JobSystem::getInstance().parallelFor(count, minPointsPerChunk, [&](size_t begin, size_t end, unsigned){
+        for(size_t i=begin; i<end; i++){
+            glm::vec3 value(0);
+            if(mask[i] > 0.f && !octree.empty()) value = fieldAt({position[0][i], position[1][i], position[2][i]});
+            for(int k=0; k<3; k++) field[k][i] = value[k];
+        }
+    });
+}
+
+// periapsis direction P and the direction a quarter turn later Q, columns of Ry(node) * Rx(inclination) * Ry(periapsis)
+static void orbitBasis(const Orbit &orbit, glm::vec3 &P, glm::vec3 &Q){
+    glm::mat3 rotation = glm::mat3(glm::rotate(glm::mat4(1.f), orbit.ascendingNode, glm::vec3(0, 1, 0))
+        * glm::rotate(glm::mat4(1.f), orbit.inclination, glm::vec3(1, 0, 0))
+        * glm::rotate(glm::mat4(1.f), orbit.periapsisArgument, glm::vec3(0, 1, 0)));
+    P = rotation[0];
+    Q = -rotation[2];
+}
+
+// solves Kepler's equation E - e sin(E) = M with Newton
+static float eccentricAnomaly(float meanAnomaly, float eccentricity){
+    float E = eccentricity < 0.8f ? meanAnomaly : glm::pi<float>();
+    for(int i=0; i<10; i++){
+        float delta = (E - eccentricity * std::sin(E) - meanAnomaly) / (1.f - eccentricity * std::cos(E));
+        E -= delta;
+        if(std::abs(delta) < 1e-6f) break;
+    }
+    return E;
+}
+
+void Orbit::stateAt(double time, glm::vec3 &position, glm::vec3 &velocity) const {
+    const double twoPi = 2.0 * glm::pi<double>();
+    double a = semiMajorAxis;
+    double meanMotion = std::sqrt(gravitationalParameter / (a * a * a));
+    // double so the anomaly stays precise after a long time
+    double meanAnomaly = std::fmod(meanAnomalyAtEpoch + meanMotion * (time - epoch), twoPi);
+    if(meanAnomaly < 0.0) meanAnomaly += twoPi;
+
+    float E = eccentricAnomaly(meanAnomaly, eccentricity);
+    float cosE = std::cos(E), sinE = std::sin(E);
+    float minorRatio = std::sqrt(1.f - eccentricity * eccentricity);
+
+    glm::vec3 P, Q;
+    orbitBasis(*this, P, Q);
+    position = semiMajorAxis * ((cosE - eccentricity) * P + minorRatio * sinE * Q);
+
+    float radius = semiMajorAxis * (1.f - eccentricity * cosE);
+    float speedScale = std::sqrt(gravitationalParameter * semiMajorAxis) / radius;
+    velocity = speedScale * (-sinE * P + minorRatio * cosE * Q);
+}
+
+bool Orbit::setState(const glm::vec3 &position, const glm::vec3 &velocity, double time){
+    const float mu = gravitationalParameter;
+    float radius = glm::length(position);
+    glm::vec3 angularMomentum = glm::cross(position, velocity);
+    float angularMomentumLength = glm::length(angularMomentum);
+    if(radius <= 0.f || angularMomentumLength < 1e-6f) return false;
+
+    float energy = 0.5f * glm::dot(velocity, velocity) - mu / radius;
+    glm::vec3 eccentricityVector = glm::cross(velocity, angularMomentum) / mu - position / radius;
+    float e = glm::length(eccentricityVector);
+    if(energy >= 0.f || e >= 1.f) return false;
+
+    glm::vec3 W = angularMomentum / angularMomentumLength;
+    // a circular orbit has no periapsis, the current position is taken as one
+    glm::vec3 P = e > 1e-6f ? eccentricityVector / e : position / radius;
+    glm::vec3 Q = glm::cross(W, P);
+
+    inclination = std::acos(glm::clamp(W.y, -1.f, 1.f));
+    if(std::sin(inclination) > 1e-6f){
+        ascendingNode = std::atan2(W.x, W.z);
+        periapsisArgument = std::atan2(P.y, Q.y);
+    } else {
+        // equatorial, the node is undefined
+        ascendingNode = 0.f;
+        periapsisArgument = std::atan2(-Q.x, P.x);
+    }
+
+    float trueAnomaly = std::atan2(glm::dot(position, Q), glm::dot(position, P));
+    float E = 2.f * std::atan2(std::sqrt(1.f - e) * std::sin(trueAnomaly * 0.5f), std::sqrt(1.f + e) * std::cos(trueAnomaly * 0.5f));
+
+    semiMajorAxis = -mu / (2.f * energy);
+    eccentricity = e;
+    meanAnomalyAtEpoch = E - e * std::sin(E);
+    epoch = time;
+    return true;
+}
 
-            if(collision.exist){
-                if(aSeeB) shapeA.collidingEntities.emplace(entityB);
-                if(bSeeA) shapeB.collidingEntities.emplace(entityA);
-                
-                collision.aSeeB = aSeeB;
-                collision.bSeeA = bSeeA;
-                collision.entityA = entityA;
-                collision.entityB = entityB;
-                detectedCollisions.push_back(collision);
+void OrbitSystem::update(float deltaTime, const glm::vec3 &focus){
+    time += deltaTime;
+
+    for(auto &entity: mEntities){
+        auto &orbit = ecs.GetComponent<Orbit>(entity);
+        auto &transform = ecs.GetComponent<Transform>(entity);
+        RigidBody *rigidBody = ecs.HasComponent<RigidBody>(entity) ? &ecs.GetComponent<RigidBody>(entity) : nullptr;
+
+        // the orbit is in the parent's frame, the focus and the rigid body velocity in the world one
+        glm::mat3 parentBasis(1.f);
+        if(sceneGraph && sceneGraph->contains(entity)){
+            Entity parent = sceneGraph->getParent(entity);
+            if(parent != SceneGraph::ROOT) parentBasis = glm::mat3(ecs.GetComponent<Transform>(parent).getModelMatrix());
+        }
+
+        if(rigidBody){
+            float distance = glm::length(transform.getGlobalPosition() - focus);
+            if(orbit.onRails && distance < orbit.influenceRadius){
+                // continues with the orbit velocity, the physic system takes over
+                orbit.onRails = false;
+                rigidBody->type = RigidBody::RIGID;
+                rigidBody->useGravityField = true;
+                rigidBody->previousPosition = transform.getLocalPosition();
+                continue;
             }
+            if(!orbit.onRails && distance > orbit.influenceRadius * (1.f + orbit.influenceHysteresis)){
+                // back on the rails from where the integration left it, escaping bodies stay integrated
+                if(!orbit.setState(transform.getLocalPosition(), glm::inverse(parentBasis) * rigidBody->velocity, time)) continue;
+                orbit.onRails = true;
+            }
+            if(!orbit.onRails) continue;
+        }
+
+        glm::vec3 position, velocity;
+        orbit.stateAt(time, position, velocity);
+        transform.setLocalPosition(position);
+        if(rigidBody){
+            // not integrated nor moved by contacts while on the rails
+            rigidBody->type = RigidBody::KINEMATIC;
+            rigidBody->velocity = parentBasis * velocity;
         }
     }
 }
@@ -72,89 +532,345 @@ glm::mat3 PhysicSystem::processInvertInertia(CollisionShape &shape, RigidBody &r
         inertiaLocal[1][1] = (rigidBody.mass / 12.0f) * (size.x*size.x + size.z*size.z); // Iyy
         inertiaLocal[2][2] = (rigidBody.mass / 12.0f) * (size.x*size.x + size.y*size.y); // Izz
         invInertiaLocal = glm::inverse(inertiaLocal);
+    } else if(shape.shapeType == COMPOUND && shape.compound.data && !shape.compound.data->children.empty()){
+        // boîte englobante des enfants
+        glm::vec3 size = shape.compound.data->bounds.extents() * 0.5f;
+        glm::mat3 inertiaLocal(0);
+        inertiaLocal[0][0] = (rigidBody.mass / 12.0f) * (size.y*size.y + size.z*size.z);
+        inertiaLocal[1][1] = (rigidBody.mass / 12.0f) * (size.x*size.x + size.z*size.z);
+        inertiaLocal[2][2] = (rigidBody.mass / 12.0f) * (size.x*size.x + size.y*size.y);
+        invInertiaLocal = glm::inverse(inertiaLocal);
     }
 
     return invInertiaLocal;
 }
 
-void PhysicSystem::solver(){
-    for(auto overlapping: detectedCollisions){
+void PhysicSystem::ContactArrays::resize(size_t size){
+    count = size;
+    // padded so the kernel always loads full simd registers
+    size_t padded = size + simd::WIDTH;
+    bodyA.resize(padded);
+    bodyB.resize(padded);
+    for(int k=0; k<3; k++) normal[k].resize(padded);
+    restitution.resize(padded);
+    friction.resize(padded);
+    invMassSum.resize(padded, 1.f);
+}
+
+// gathers the contacts the solver handles and colors them, same filters as the former per iteration loop
+void PhysicSystem::prepareContacts(){
+    auto &index = solverBodies.entityIndex;
+    if(index.empty()) index.assign(MAX_ENTITIES, -1);
+    for(auto entity: solverBodies.entities) index[entity] = -1;
+    solverBodies.entities.clear();
+    solverBodies.rigidBodies.clear();
+    solverBodies.usedColors.clear();
+
+    auto gather = [&](Entity entity, RigidBody &rigidBody){
+        if(index[entity] < 0){
+            index[entity] = solverBodies.entities.size();
+            solverBodies.entities.push_back(entity);
+            solverBodies.rigidBodies.push_back(&rigidBody);
+            solverBodies.usedColors.push_back(0);
+        }
+        return (uint32_t) index[entity];
+    };
+
+    auto &pending = contacts.pending;
+    pending.clear();
+    size_t colorCounts[MAX_COLORS + 1] = {};
+
+    for(auto &overlapping: detectedCollisions){
         // Provisory
         if(!overlapping.aSeeB || !overlapping.bSeeA || mEntities.find(overlapping.entityA) == mEntities.end() || mEntities.find(overlapping.entityB) == mEntities.end()) continue;
 
         RigidBody &rbA = ecs.GetComponent<RigidBody>(overlapping.entityA);
         RigidBody &rbB = ecs.GetComponent<RigidBody>(overlapping.entityB);
-        Transform &tA = ecs.GetComponent<Transform>(overlapping.entityA);
-        Transform &tB = ecs.GetComponent<Transform>(overlapping.entityB);
- 
         if(rbA.type == RigidBody::KINEMATIC || rbB.type == RigidBody::KINEMATIC) continue;
         if(rbA.type == RigidBody::STATIC && rbB.type == RigidBody::STATIC) continue;
 
-        float invMassSum = rbA.invMass + rbB.invMass;
-
-        glm::vec3 relativeVelocity = rbB.velocity - rbA.velocity;
-        float velAlongNormal = glm::dot(relativeVelocity, overlapping.normal);
-        if(velAlongNormal > 0.0f) continue;
-
-        float e = std::min(rbA.restitutionCoef, rbB.restitutionCoef);
-        float num = (-(1.0f + e) * glm::dot(relativeVelocity, overlapping.normal));
-        float j = num / invMassSum;
-
-        
-        glm::vec3 impulse = j * overlapping.normal;
+        uint32_t a = gather(overlapping.entityA, rbA);
+        uint32_t b = gather(overlapping.entityB, rbB);
+
+        // static bodies are only read, several contacts of a color can share them
+        uint64_t used = 0;
+        if(rbA.type == RigidBody::RIGID) used |= solverBodies.usedColors[a];
+        if(rbB.type == RigidBody::RIGID) used |= solverBodies.usedColors[b];
+        int color = 0;
+        while(color < MAX_COLORS && (used >> color) & 1) color++;
+        if(color < MAX_COLORS){
+            if(rbA.type == RigidBody::RIGID) solverBodies.usedColors[a] |= uint64_t(1) << color;
+            if(rbB.type == RigidBody::RIGID) solverBodies.usedColors[b] |= uint64_t(1) << color;
+        }
+        colorCounts[color]++;
+        pending.push_back({&overlapping, a, b, color});
+    }
 
-        if(overlapping.aSeeB && rbA.type == RigidBody::RIGID) rbA.velocity -= impulse * rbA.invMass;
-        if(overlapping.bSeeA && rbB.type == RigidBody::RIGID) rbB.velocity += impulse * rbB.invMass;
+    size_t bodyCount = solverBodies.rigidBodies.size();
+    for(int k=0; k<3; k++) solverBodies.velocity[k].resize(bodyCount);
+    solverBodies.velocityWeight.resize(bodyCount);
+    for(size_t i=0; i<bodyCount; i++){
+        RigidBody &rigidBody = *solverBodies.rigidBodies[i];
+        for(int k=0; k<3; k++) solverBodies.velocity[k][i] = rigidBody.velocity[k];
+        solverBodies.velocityWeight[i] = rigidBody.type == RigidBody::RIGID ? rigidBody.invMass : 0.f;
+    }
 
-        
-        // friction
-        glm::vec3 tangent = relativeVelocity - (overlapping.normal * glm::dot(relativeVelocity, overlapping.normal));
-        if (glm::length(tangent) > 0.0001f)
-            tangent = glm::normalize(tangent);
-        else
-            tangent = glm::vec3(0.0f);
+    // counting sort by color, the detection order is kept inside a color
+    size_t offsets[MAX_COLORS + 1];
+    size_t offset = 0;
+    contacts.colors.clear();
+    for(int color=0; color<=MAX_COLORS; color++){
+        offsets[color] = offset;
+        if(color < MAX_COLORS && colorCounts[color] > 0) contacts.colors.push_back({offset, offset + colorCounts[color]});
+        offset += colorCounts[color];
+    }
+    contacts.serialBegin = offsets[MAX_COLORS];
+    contacts.resize(pending.size());
+    stats.solvedContacts = pending.size();
+    stats.colors = contacts.colors.size();
+    stats.serialContacts = colorCounts[MAX_COLORS];
+
+    for(auto &contact: pending){
+        size_t i = offsets[contact.color]++;
+        const RigidBody &rbA = *solverBodies.rigidBodies[contact.a];
+        const RigidBody &rbB = *solverBodies.rigidBodies[contact.b];
+        contacts.bodyA[i] = contact.a;
+        contacts.bodyB[i] = contact.b;
+        for(int k=0; k<3; k++) contacts.normal[k][i] = contact.shape->normal[k];
+        contacts.restitution[i] = std::min(rbA.restitutionCoef, rbB.restitutionCoef);
+        contacts.friction[i] = std::sqrt(rbA.frictionCoef * rbB.frictionCoef);
+        contacts.invMassSum[i] = rbA.invMass + rbB.invMass;
+    }
+}
 
-        num = -glm::dot(relativeVelocity, tangent);
-        float jt = num / invMassSum;
+// normal and friction impulses of the contacts [first, first+count), none of them share a rigid body
+void PhysicSystem::solveContacts(size_t first, int count){
+    using namespace simd;
+    float velocityA[3][WIDTH] = {}, velocityB[3][WIDTH] = {};
+    float weightA[WIDTH] = {}, weightB[WIDTH] = {};
+    for(int lane=0; lane<count; lane++){
+        uint32_t a = contacts.bodyA[first + lane], b = contacts.bodyB[first + lane];
+        for(int k=0; k<3; k++){
+            velocityA[k][lane] = solverBodies.velocity[k][a];
+            velocityB[k][lane] = solverBodies.velocity[k][b];
+        }
+        weightA[lane] = solverBodies.velocityWeight[a];
+        weightB[lane] = solverBodies.velocityWeight[b];
+    }
 
+    Float normal[3], relativeVelocity[3];
+    for(int k=0; k<3; k++){
+        normal[k] = load(&contacts.normal[k][first]);
+        relativeVelocity[k] = load(velocityB[k]) - load(velocityA[k]);
+    }
+    Float invMassSum = load(&contacts.invMassSum[first]);
+
+    Float velAlongNormal = relativeVelocity[0] * normal[0] + relativeVelocity[1] * normal[1] + relativeVelocity[2] * normal[2];
+    Float separating = velAlongNormal > Float(0.f);
+    Float j = -(Float(1.f) + load(&contacts.restitution[first])) * velAlongNormal / invMassSum;
+
+    // friction
+    Float tangent[3];
+    for(int k=0; k<3; k++) tangent[k] = relativeVelocity[k] - normal[k] * velAlongNormal;
+    Float tangentLength = sqrt(tangent[0] * tangent[0] + tangent[1] * tangent[1] + tangent[2] * tangent[2]);
+    Float hasTangent = tangentLength > Float(0.0001f);
+    for(int k=0; k<3; k++) tangent[k] = select(hasTangent, tangent[k] / tangentLength, Float(0.f));
+
+    Float jt = -(relativeVelocity[0] * tangent[0] + relativeVelocity[1] * tangent[1] + relativeVelocity[2] * tangent[2]) / invMassSum;
+    Float maxFriction = j * load(&contacts.friction[first]);
+    jt = min(max(jt, -maxFriction), maxFriction);
+
+    // A gets -impulse + frictionImpulse, B the opposite
+    float delta[3][WIDTH];
+    for(int k=0; k<3; k++) store(delta[k], andNot(separating, normal[k] * j - tangent[k] * jt));
+
+    for(int lane=0; lane<count; lane++){
+        uint32_t a = contacts.bodyA[first + lane], b = contacts.bodyB[first + lane];
+        for(int k=0; k<3; k++){
+            if(weightA[lane] != 0.f) solverBodies.velocity[k][a] -= delta[k][lane] * weightA[lane];
+            if(weightB[lane] != 0.f) solverBodies.velocity[k][b] += delta[k][lane] * weightB[lane];
+        }
+    }
+}
 
-        float frictionCoef = std::sqrt(rbA.frictionCoef * rbB.frictionCoef);
+void PhysicSystem::solver(){
+    auto &jobs = JobSystem::getInstance();
+    for(auto &color: contacts.colors){
+        size_t groups = (color.second - color.first + simd::WIDTH - 1) / simd::WIDTH;
+        jobs.parallelFor(groups, minContactGroupsPerChunk, [this, &color](size_t begin, size_t end, unsigned){
+            for(size_t group=begin; group<end; group++){
+                size_t first = color.first + group * simd::WIDTH;
+                solveContacts(first, std::min<size_t>(simd::WIDTH, color.second - first));
+            }
+        });
+    }
 
-        if(jt > j*frictionCoef){
-            jt = j * frictionCoef;
-        } else if(jt < -j*frictionCoef){
-            jt = -j * frictionCoef;
-        };
+    for(size_t i=contacts.serialBegin; i<contacts.count; i++) solveContacts(i, 1);
+}
 
-        glm::vec3 frictionImpulse = jt * tangent;
+float PhysicSystem::contactResidual() const {
+    float residual = 0.f;
+    for(size_t i=0; i<contacts.count; i++){
+        uint32_t a = contacts.bodyA[i], b = contacts.bodyB[i];
+        float velAlongNormal = 0.f;
+        for(int k=0; k<3; k++) velAlongNormal += (solverBodies.velocity[k][b] - solverBodies.velocity[k][a]) * contacts.normal[k][i];
+        residual = std::max(residual, -velAlongNormal);
+    }
+    return residual;
+}
 
-        if(rbA.type == RigidBody::STATIC && rbB.type == RigidBody::RIGID && overlapping.bSeeA)
-        {
-            rbB.velocity -= frictionImpulse * rbB.invMass;
-        } else if(rbB.type == RigidBody::STATIC && rbA.type == RigidBody::RIGID && overlapping.aSeeB)
-        {
-            rbA.velocity += frictionImpulse * rbA.invMass;
-        } 
-        else if(rbA.type == RigidBody::RIGID && rbB.type == RigidBody::RIGID && overlapping.aSeeB && overlapping.bSeeA)
-        {
-            rbA.velocity += frictionImpulse * rbA.invMass;
-            rbB.velocity -= frictionImpulse * rbB.invMass;
-        }
+void PhysicSystem::storeVelocities(){
+    for(size_t i=0; i<solverBodies.rigidBodies.size(); i++){
+        if(solverBodies.velocityWeight[i] == 0.f) continue;
+        solverBodies.rigidBodies[i]->velocity = {solverBodies.velocity[0][i], solverBodies.velocity[1][i], solverBodies.velocity[2][i]};
     }
 }
 
 void PhysicSystem::accumulateForces(){
+    bodies.rigidBodies.clear();
+    bodies.transforms.clear();
+    bodies.continuousIndices.clear();
+    bodies.continuousShapes.clear();
+    stats.rigidBodies = stats.kinematicBodies = stats.staticBodies = 0;
+
     for(auto &entity : mEntities){
         auto &rigidBody = ecs.GetComponent<RigidBody>(entity);
-        auto &shape = ecs.GetComponent<CollisionShape>(entity);
+        if(rigidBody.type == RigidBody::RIGID) stats.rigidBodies++;
+        else if(rigidBody.type == RigidBody::KINEMATIC) stats.kinematicBodies++;
+        else stats.staticBodies++;
         if(rigidBody.dirty){
+            auto &shape = ecs.GetComponent<CollisionShape>(entity);
             rigidBody.invInertia = processInvertInertia(shape, rigidBody);
             rigidBody.invMass = 1.f / rigidBody.mass;
+            rigidBody.dirty = false;
+        }
+
+        auto& transform = ecs.GetComponent<Transform>(entity);
+
+        // rigid bodies get their gravity and forces in the integration kernel
+        if(rigidBody.type == RigidBody::RIGID){
+            rigidBody.previousPosition = transform.getLocalPosition();
+            rigidBody.hasPreviousPosition = true;
+            if(rigidBody.continuous){
+                bodies.continuousIndices.push_back(bodies.rigidBodies.size());
+                bodies.continuousShapes.push_back(&ecs.GetComponent<CollisionShape>(entity));
+            }
+            bodies.rigidBodies.push_back(&rigidBody);
+            bodies.transforms.push_back(&transform);
+            continue;
+        }
+
+        if(rigidBody.useGravityAnchor){
+            rigidBody.gravityDirection = glm::normalize(rigidBody.gravityAnchor - transform.getGlobalPosition());
         }
         rigidBody.applyForces();
     }
 }
 
+void PhysicSystem::BodyArrays::resize(size_t size){
+    count = size;
+    // padded so the kernel always works on full simd registers
+    size_t padded = (size + simd::WIDTH - 1) / simd::WIDTH * simd::WIDTH;
+    for(int k=0; k<3; k++){
+        position[k].resize(padded);
+        anchor[k].resize(padded);
+        gravityDirection[k].resize(padded);
+        velocity[k].resize(padded);
+        forces[k].resize(padded);
+        displacement[k].resize(padded);
+        field[k].resize(padded);
+    }
+    useAnchor.resize(padded);
+    useField.resize(padded);
+    mass.resize(padded);
+    invMass.resize(padded, 1.f);
+    damping.resize(padded);
+}
+
+// gravity direction, forces, damped velocity and displacement for every body, same operations as RigidBody::applyForces and RigidBody::update
+void PhysicSystem::integrationKernel(BodyArrays &bodies, size_t padded, float deltaTime){
+    using namespace simd;
+    const Float dt = deltaTime;
+    const Float g = G;
+
+    for(size_t i=0; i<padded; i+=WIDTH){
+        Float direction[3], anchorOffset[3];
+        for(int k=0; k<3; k++){
+            direction[k] = load(&bodies.gravityDirection[k][i]);
+            anchorOffset[k] = load(&bodies.anchor[k][i]) - load(&bodies.position[k][i]);
+        }
+
+        Float field[3];
+        for(int k=0; k<3; k++) field[k] = load(&bodies.field[k][i]);
+
+        Float useAnchor = Float(0.f) < load(&bodies.useAnchor[i]);
+        Float lengthSq = anchorOffset[0] * anchorOffset[0] + anchorOffset[1] * anchorOffset[1] + anchorOffset[2] * anchorOffset[2];
+        Float invLength = Float(1.f) / sqrt(lengthSq);
+        Float mass = load(&bodies.mass[i]);
+        Float invMass = load(&bodies.invMass[i]);
+        Float damping = load(&bodies.damping[i]);
+
+        // a null field keeps the previous direction and the constant gravity
+        Float fieldLengthSq = field[0] * field[0] + field[1] * field[1] + field[2] * field[2];
+        Float useField = (Float(0.f) < load(&bodies.useField[i])) & (Float(0.f) < fieldLengthSq);
+        Float fieldLength = sqrt(fieldLengthSq);
+        Float invFieldLength = Float(1.f) / fieldLength;
+        Float forceScale = select(useField, fieldLength * mass, g * mass);
+
+        for(int k=0; k<3; k++){
+            direction[k] = select(useAnchor, anchorOffset[k] * invLength, direction[k]);
+            direction[k] = select(useField, field[k] * invFieldLength, direction[k]);
+            Float force = forceScale * direction[k];
+            Float velocity = load(&bodies.velocity[k][i]);
+            velocity = velocity + force * invMass * dt;
+            velocity = velocity * damping;
+
+            store(&bodies.gravityDirection[k][i], direction[k]);
+            store(&bodies.forces[k][i], force);
+            store(&bodies.velocity[k][i], velocity);
+            store(&bodies.displacement[k][i], velocity * dt);
+        }
+    }
+}
+
+// bodies were collected by accumulateForces, nothing is added or removed during the step
+void PhysicSystem::integrate(float deltaTime){
+    bodies.resize(bodies.rigidBodies.size());
+
+    for(size_t i=0; i<bodies.count; i++){
+        auto& rigidBody = *bodies.rigidBodies[i];
+        // the model matrix is not updated during the step, this is the position the anchor direction always used
+        glm::vec3 position = bodies.transforms[i]->getGlobalPosition();
+        for(int k=0; k<3; k++){
+            bodies.position[k][i] = position[k];
+            bodies.anchor[k][i] = rigidBody.gravityAnchor[k];
+            bodies.gravityDirection[k][i] = rigidBody.gravityDirection[k];
+            bodies.velocity[k][i] = rigidBody.velocity[k];
+        }
+        bodies.useAnchor[i] = rigidBody.useGravityAnchor ? 1.f : 0.f;
+        bodies.useField[i] = rigidBody.useGravityField && gravityField ? 1.f : 0.f;
+        bodies.mass[i] = rigidBody.mass;
+        bodies.invMass[i] = rigidBody.invMass;
+        bodies.damping[i] = rigidBody.linearDamping;
+    }
+
+    if(gravityField){
+        gravityField->update();
+        gravityField->evaluate(bodies.position, bodies.useField, bodies.field, bodies.count);
+    }
+
+    integrationKernel(bodies, bodies.position[0].size(), deltaTime);
+    if(!bodies.continuousIndices.empty()) sweepContinuousBodies(deltaTime);
+
+    for(size_t i=0; i<bodies.count; i++){
+        auto& rigidBody = *bodies.rigidBodies[i];
+        rigidBody.gravityDirection = {bodies.gravityDirection[0][i], bodies.gravityDirection[1][i], bodies.gravityDirection[2][i]};
+        rigidBody.forces = {bodies.forces[0][i], bodies.forces[1][i], bodies.forces[2][i]};
+        rigidBody.velocity = {bodies.velocity[0][i], bodies.velocity[1][i], bodies.velocity[2][i]};
+        bodies.transforms[i]->translate({bodies.displacement[0][i], bodies.displacement[1][i], bodies.displacement[2][i]});
+    }
+}
+
 
 void RigidBody::applyForces(){
     forces = G * mass * gravityDirection;
@@ -164,30 +880,34 @@ void RigidBody::addLinearImpulse(const glm::vec3 &imp){
     velocity = velocity + imp;
 }
 
+void RigidBody::teleport(Transform &transform, const glm::vec3 &localPosition){
+    transform.setLocalPosition(localPosition);
+    previousPosition = localPosition;
+}
+
 void RigidBody::update(float delta){
-    const float damping = 0.98f;
     glm::vec3 acceleration = forces * invMass;
     velocity = velocity + acceleration * delta;
-    velocity = velocity * damping;
+    velocity = velocity * linearDamping;
 }
 
 
 void PhysicSystem::update(float deltaTime){
-    for(auto &entity: mEntities){
-        auto& rigidBody = ecs.GetComponent<RigidBody>(entity);
-        
-        if(rigidBody.useGravityAnchor){
-            auto& transform = ecs.GetComponent<Transform>(entity);
-            rigidBody.gravityDirection = glm::normalize(rigidBody.gravityAnchor - transform.getGlobalPosition());
-        }
-    }
-
+    auto start = StatsClock::now();
     accumulateForces();
+    prepareContacts();
+    stats.prepareTime = millisecondsSince(start);
 
+    start = StatsClock::now();
     for(int i=0; i<impulseIteration; i++){
         solver();
     }
+    stats.solverIterations = impulseIteration;
+    stats.solverResidual = contactResidual();
+    storeVelocities();
+    stats.solverTime = millisecondsSince(start);
 
+    start = StatsClock::now();
     for(auto overlapping: detectedCollisions){
         //!overlapping.aSeeB || !overlapping.bSeeA || 
         if(mEntities.find(overlapping.entityA) == mEntities.end() || mEntities.find(overlapping.entityB) == mEntities.end()) continue;
@@ -220,41 +940,101 @@ void PhysicSystem::update(float deltaTime){
             tB.translate(overlapping.normal * overlapping.correctionDepth);
         } 
     }
+    stats.correctionTime = millisecondsSince(start);
 
+    start = StatsClock::now();
+    integrate(deltaTime);
+    stats.integrationTime = millisecondsSince(start);
+}
+
+// continuous bodies bounce at their times of impact and travel the rest of the step with the new velocity,
+// the other colliders are considered still
+void PhysicSystem::sweepContinuousBodies(float deltaTime){
+    // impacts resolved per body and step, what is left after the last one is dropped
+    const int maxSweeps = 4;
+
+    sweepTargets.clear();
     for(auto &entity: mEntities){
-        
-        auto& rigidBody = ecs.GetComponent<RigidBody>(entity);
-        auto& transform = ecs.GetComponent<Transform>(entity);
-        auto& shape = ecs.GetComponent<CollisionShape>(entity);
+        sweepTargets.emplace_back(&ecs.GetComponent<CollisionShape>(entity), &ecs.GetComponent<RigidBody>(entity));
+    }
 
-        if(rigidBody.type == RigidBody::STATIC || rigidBody.type == RigidBody::KINEMATIC){
-            continue;
-        } else {
-            rigidBody.update(deltaTime);
-            transform.translate(rigidBody.velocity * deltaTime);
+    for(size_t n=0; n<bodies.continuousIndices.size(); n++){
+        size_t i = bodies.continuousIndices[n];
+        CollisionShape &shape = *bodies.continuousShapes[n];
+        RigidBody &rigidBody = *bodies.rigidBodies[i];
+
+        glm::vec3 displacement(bodies.displacement[0][i], bodies.displacement[1][i], bodies.displacement[2][i]);
+        glm::vec3 velocity(bodies.velocity[0][i], bodies.velocity[1][i], bodies.velocity[2][i]);
+        // cached world position plus the corrections already applied this step
+        glm::vec3 start = shape.world.position + bodies.transforms[i]->getLocalPosition() - rigidBody.previousPosition;
+        glm::vec3 travelled(0.f);
+        float remaining = 1.f;
+
+        for(int sweep=0; sweep<maxSweeps; sweep++){
+            glm::vec3 sweptCenter = start + displacement * 0.5f;
+            float sweptRadius = shape.boundingRadius() + glm::length(displacement) * 0.5f;
+
+            float firstImpact = FLT_MAX;
+            glm::vec3 impactNormal;
+            RigidBody *impactBody = nullptr;
+            for(auto &[target, targetBody]: sweepTargets){
+                if(target == &shape || targetBody->type == RigidBody::KINEMATIC) continue;
+                if(!CollisionShape::canSee(shape, *target) || !CollisionShape::canSee(*target, shape)) continue;
+
+                float targetRadius = target->boundingRadius();
+                if(targetRadius != FLT_MAX && glm::length(target->world.position - sweptCenter) > sweptRadius + targetRadius) continue;
+
+                glm::vec3 normal;
+                float t = CollisionShape::timeOfImpact(shape, start, displacement, *target, normal);
+                if(t >= 0.f && t < firstImpact){
+                    firstImpact = t;
+                    impactNormal = normal;
+                    impactBody = targetBody;
+                }
+            }
+            if(!impactBody){
+                travelled += displacement;
+                break;
+            }
 
-            // gravity
-            // rigidBody.velocity += G * deltaTime * rigidBody.gravityDirection;
+            travelled += displacement * firstImpact;
+            start += displacement * firstImpact;
 
-            // rigidBody.velocity += rigidBody.impulse * rigidBody.invMass * deltaTime;
-            // rigidBody.angularVelocity += rigidBody.torque * rigidBody.invInertia * deltaTime;
-            
-            // rigidBody.impulse = glm::vec3(0); 
-            // rigidBody.torque = glm::vec3(0);
+            float velAlongNormal = glm::dot(velocity, impactNormal);
+            if(velAlongNormal < 0.f){
+                float e = std::min(rigidBody.restitutionCoef, impactBody->restitutionCoef);
+                velocity -= (1.f + e) * velAlongNormal * impactNormal;
+            }
+            // touching and moving away, the next sweep can't hit the same collider at once
+            remaining *= 1.f - firstImpact;
+            displacement = velocity * deltaTime * remaining;
+        }
 
-            // transform.translate(rigidBody.velocity * deltaTime);
-            
-            // const float speed = glm::length(rigidBody.angularVelocity);
-            // if (speed > 0.001f) { // Évite les divisions par 0
-            //     glm::quat currentRot = glm::quat(transform.getLocalRotation()); 
-            //     glm::vec3 axis = rigidBody.angularVelocity / speed;
-                
-            //     glm::quat deltaRot = glm::angleAxis(speed * deltaTime, axis);
-            //     transform.setLocalRotation(deltaRot * currentRot);
-            // }
+        for(int k=0; k<3; k++){
+            bodies.displacement[k][i] = travelled[k];
+            bodies.velocity[k][i] = velocity[k];
         }
     }
+}
+
+void PhysicSystem::applyInterpolation(float alpha){
+    interpolatedTransforms.clear();
+    for(auto &entity: mEntities){
+        auto& rigidBody = ecs.GetComponent<RigidBody>(entity);
+        if(rigidBody.type != RigidBody::RIGID || !rigidBody.hasPreviousPosition) continue;
+
+        auto& transform = ecs.GetComponent<Transform>(entity);
+        glm::vec3 current = transform.getLocalPosition();
+        interpolatedTransforms.emplace_back(&transform, current);
+        transform.setLocalPosition(glm::mix(rigidBody.previousPosition, current, alpha));
+    }
+}
 
+void PhysicSystem::removeInterpolation(){
+    for(auto &[transform, position]: interpolatedTransforms){
+        transform->setLocalPosition(position);
+    }
+    interpolatedTransforms.clear();
 }
 
 
@@ -329,9 +1109,8 @@ void initBuffer(GLuint &VAO, std::vector<float> &vertex_buffer_data, std::vector
 
 void PhysicDebugSystem::init() {
     program = Program("shaders/debug/vertex.glsl", "shaders/debug/fragment.glsl");
-
-    auto p = Camera::getInstance().getP();
-    program.updateProjectionMatrix(p);
+    scaleUniform = program.getUniform("scale");
+    colorUniform = program.getUniform("albedo");
 
     // Génération de la sphère
     std::vector<float> sphereVertices;
@@ -387,16 +1166,9 @@ void PhysicDebugSystem::init() {
 
 void PhysicDebugSystem::update(){
     glUseProgram(program.programID);
-    GLuint scaleLocation = glGetUniformLocation(program.programID, "scale");
-    
-    glm::mat4 V = Camera::getInstance().getV();
-    program.updateViewMatrix(V);
-    glm::mat4 camProj = Camera::getInstance().getP();
-    program.updateProjectionMatrix(camProj);
     
     GLuint tempVBO;
     glGenBuffers(1, &tempVBO);
-    GLuint colorLocation = glGetUniformLocation(program.programID, "albedo");
     
     glLineWidth(2.0f);
     
@@ -405,6 +1177,8 @@ void PhysicDebugSystem::update(){
     for(auto &entity: mEntities){
         auto& shape = ecs.GetComponent<CollisionShape>(entity);
         auto& transform = ecs.GetComponent<Transform>(entity);
+        // already visible through their drawable
+        if(shape.shapeType == TRIANGLE_MESH || shape.shapeType == HEIGHTFIELD) continue;
 
         glm::mat4 model;
         if(shape.shapeType != AABB){
@@ -417,22 +1191,55 @@ void PhysicDebugSystem::update(){
         program.updateModelMatrix(model);
 
         if(shape.isAnythingColliding()) 
-            glUniform4f(colorLocation, 1,0,0,1);
-        else glUniform4f(colorLocation, 0,1,0,1);
+            program.set(colorUniform, glm::vec4(1,0,0,1));
+        else program.set(colorUniform, glm::vec4(0,1,0,1));
+
+        if(shape.shapeType == COMPOUND){
+            if(!shape.compound.data) continue;
+            glBindVertexArray(0);
+            for(auto &child: shape.compound.data->children){
+                glm::mat4 childModel = model * child.localMatrix;
+                switch(child.shape.shapeType){
+                    case SPHERE:
+                        program.updateModelMatrix(childModel);
+                        program.set(scaleUniform, glm::vec3(child.shape.sphere.radius));
+                        glBindVertexArray(sphereVAO);
+                        glDrawElements(GL_LINES, sphereIndexCount, GL_UNSIGNED_INT, (void*)0);
+                        break;
+                    case OOBB:
+                        program.updateModelMatrix(childModel);
+                        program.set(scaleUniform, child.shape.oobb.halfExtents);
+                        glBindVertexArray(boxVAO);
+                        glDrawElements(GL_LINES, boxIndexCount, GL_UNSIGNED_INT, (void*)0);
+                        break;
+                    case AABB:
+                        // stays on the world axes, diag is the half size the tests use
+                        program.updateModelMatrix(glm::translate(glm::mat4(1), glm::vec3(childModel[3])));
+                        program.set(scaleUniform, child.shape.aabb.diag);
+                        glBindVertexArray(boxVAO);
+                        glDrawElements(GL_LINES, boxIndexCount, GL_UNSIGNED_INT, (void*)0);
+                        break;
+                    default:
+                        break;
+                }
+            }
+            glBindVertexArray(0);
+            continue;
+        }
 
         int indexCount = 0;
         if(shape.shapeType == SPHERE){
             indexCount = sphereIndexCount;
             float r = shape.sphere.radius;
-            glUniform3f(scaleLocation, r,r,r);
+            program.set(scaleUniform, glm::vec3(r));
             glBindVertexArray(sphereVAO);
         } else if (shape.shapeType == PLANE){
             indexCount = quadIndexCount;
             glBindVertexArray(quadVAO);
         } else if(shape.shapeType == OOBB || shape.shapeType == AABB){
             indexCount = boxIndexCount;
-            glm::vec3 scale = shape.oobb.halfExtents;
-            glUniform3f(scaleLocation, scale.x, scale.y, scale.z);
+            glm::vec3 scale = shape.shapeType == OOBB ? shape.oobb.halfExtents : shape.aabb.diag;
+            program.set(scaleUniform, scale);
             glBindVertexArray(boxVAO);
         } else if (shape.shapeType == RAY){
             glm::vec3 points[2] = { glm::vec3(0), shape.ray.ray_direction * shape.ray.length };